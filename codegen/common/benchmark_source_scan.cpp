@@ -0,0 +1,101 @@
+// This file is part of Desktop App Toolkit,
+// a set of libraries for developing nice desktop applications.
+//
+// For license and copyright information please follow this link:
+// https://github.com/desktop-app/legal/blob/master/LEGAL
+//
+// Times ScanSource() with the rules of codegen_lang and codegen_style
+// subsets on the .cpp/.h/.mm files of a sources tree read into memory.
+//
+// Usage: codegen_common_benchmark_source_scan <sources folder> [repeats]
+//
+#include "codegen/common/source_scan.h"
+
+#include <algorithm>
+#include <iostream>
+#include <limits>
+#include <vector>
+#include <QtCore/QElapsedTimer>
+#include <QtCore/QFile>
+
+namespace {
+
+using namespace codegen::common;
+
+// The same as in codegen/lang/subsets.cpp and codegen/style/subsets.cpp.
+const auto kLangRules = ScanRules{
+	.tokenPrefix = "lng_",
+	.keepPrefix = true,
+	.templateStart = "phrase<",
+	.includes = true,
+};
+const auto kStyleRules = ScanRules{
+	.tokenPrefix = "st::",
+	.includes = true,
+};
+
+[[nodiscard]] std::vector<QByteArray> ReadSources(const QString &folder) {
+	auto result = std::vector<QByteArray>();
+	for (const auto &file : CollectSources({ folder })) {
+		auto f = QFile(file.absolute);
+		if (f.open(QIODevice::ReadOnly)) {
+			result.push_back(f.readAll());
+		}
+	}
+	return result;
+}
+
+void Measure(
+		const char *name,
+		const ScanRules &rules,
+		const std::vector<QByteArray> &contents,
+		qint64 bytes,
+		int repeats) {
+	auto timer = QElapsedTimer();
+	auto best = std::numeric_limits<qint64>::max();
+	auto found = size_t();
+	for (auto repeat = 0; repeat != repeats; ++repeat) {
+		found = 0;
+		timer.start();
+		for (const auto &content : contents) {
+			auto scanned = ScannedSource();
+			ScanSource(content.constData(), content.size(), rules, scanned);
+			found += scanned.tokens.size()
+				+ scanned.templates.size()
+				+ scanned.includes.size();
+		}
+		best = std::min(best, timer.nsecsElapsed());
+	}
+	std::cout
+		<< name << ": "
+		<< (best / 1000) << " us, "
+		<< (bytes * 1000 / std::max(best, qint64(1))) << " MB/s, "
+		<< found << " found\n";
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+	if (argc != 2 && argc != 3) {
+		std::cerr << "Usage: " << argv[0] << " <sources folder> [repeats]\n";
+		return 1;
+	}
+	const auto contents = ReadSources(QString::fromLocal8Bit(argv[1]));
+	const auto repeats = (argc == 3) ? QByteArray(argv[2]).toInt() : 5;
+	if (contents.empty() || repeats <= 0) {
+		std::cerr << "No sources found or bad repeats count.\n";
+		return 1;
+	}
+	auto bytes = qint64();
+	for (const auto &content : contents) {
+		bytes += content.size();
+	}
+	std::cout
+		<< contents.size() << " files, "
+		<< bytes << " bytes, best of "
+		<< repeats << " repeats\n";
+
+	Measure("lang", kLangRules, contents, bytes, repeats);
+	Measure("style", kStyleRules, contents, bytes, repeats);
+	return 0;
+}
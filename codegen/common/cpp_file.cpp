@@ -13,6 +13,19 @@ namespace codegen {
 namespace common {
 namespace {
 
+QByteArray escapeDepfilePath(const QString &path) {
+	auto result = QByteArray();
+	for (const auto ch : QDir::fromNativeSeparators(path).toUtf8()) {
+		if (ch == ' ' || ch == '#') {
+			result.append('\\');
+		} else if (ch == '$') {
+			result.append('$');
+		}
+		result.append(ch);
+	}
+	return result;
+}
+
 void writeLicense(QTextStream &stream, const ProjectInfo &project) {
 	stream << "\
 // WARNING! All changes made in this file will be lost!\n\
@@ -110,5 +123,20 @@ bool TouchTimestamp(const QString &basepath) {
 	return file.open(QIODevice::WriteOnly) && (file.write("1", 1) == 1);
 }
 
+bool WriteDepfile(const QString &basepath, QStringList dependencies) {
+	dependencies.sort();
+	dependencies.removeDuplicates();
+
+	auto content = escapeDepfilePath(basepath + ".timestamp") + ':';
+	for (const auto &path : std::as_const(dependencies)) {
+		content.append(" \\\n ").append(escapeDepfilePath(path));
+	}
+	content.append('\n');
+
+	auto file = QFile(basepath + ".d");
+	return file.open(QIODevice::WriteOnly)
+		&& (file.write(content) == content.size());
+}
+
 } // namespace common
 } // namespace codegen
@@ -7,6 +7,7 @@
 #pragma once
 
 #include <QtCore/QString>
+#include <QtCore/QStringList>
 #include <QtCore/QVector>
 #include <QtCore/QTextStream>
 
@@ -54,5 +55,8 @@ private:
 
 bool TouchTimestamp(const QString &basepath);
 
+// Writes a Makefile-format "basepath.d" with "basepath.timestamp" target.
+bool WriteDepfile(const QString &basepath, QStringList dependencies);
+
 } // namespace common
 } // namespace codegen
@@ -0,0 +1,60 @@
+// This file is part of Desktop App Toolkit,
+// a set of libraries for developing nice desktop applications.
+//
+// For license and copyright information please follow this link:
+// https://github.com/desktop-app/legal/blob/master/LEGAL
+//
+#include "codegen/common/directory_cache.h"
+
+#include <QtCore/QDir>
+#include <QtCore/QFileInfo>
+#include <QtCore/QHash>
+#include <QtCore/QSet>
+
+namespace codegen {
+namespace common {
+namespace {
+
+QString normalizedName(const QString &name) {
+#if defined Q_OS_WIN || defined Q_OS_MAC
+	return name.toLower();
+#else // Q_OS_WIN || Q_OS_MAC
+	return name;
+#endif // Q_OS_WIN || Q_OS_MAC
+}
+
+const QSet<QString> &directoryEntries(const QString &path) {
+	static auto Directories = QHash<QString, QSet<QString>>();
+
+	const auto key = normalizedName(path);
+	auto i = Directories.find(key);
+	if (i == Directories.end()) {
+		auto entries = QSet<QString>();
+		const auto list = QDir(path).entryList(
+			QDir::AllEntries | QDir::Hidden | QDir::System | QDir::NoDotAndDotDot);
+		for (const auto &name : list) {
+			entries.insert(normalizedName(name));
+		}
+		i = Directories.insert(key, std::move(entries));
+	}
+	return *i;
+}
+
+} // namespace
+
+bool FileExists(const QString &path) {
+	const auto absolute = QDir::cleanPath(QFileInfo(path).absoluteFilePath());
+	const auto slash = absolute.lastIndexOf('/');
+	if (slash < 0 || slash + 1 == absolute.size()) {
+		return QFileInfo::exists(path);
+	}
+	auto directory = absolute.left(slash);
+	if (directory.isEmpty() || directory.endsWith(':')) {
+		directory += '/';
+	}
+	return directoryEntries(directory).contains(
+		normalizedName(absolute.mid(slash + 1)));
+}
+
+} // namespace common
+} // namespace codegen
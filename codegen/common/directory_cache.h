@@ -0,0 +1,20 @@
+// This file is part of Desktop App Toolkit,
+// a set of libraries for developing nice desktop applications.
+//
+// For license and copyright information please follow this link:
+// https://github.com/desktop-app/legal/blob/master/LEGAL
+//
+#pragma once
+
+#include <QtCore/QString>
+
+namespace codegen {
+namespace common {
+
+// Checks file existence using a listing of its directory read once per run,
+// so probing many files in the same folders doesn't stat each of them.
+// Files created after the directory was listed are not seen. Not thread safe.
+[[nodiscard]] bool FileExists(const QString &path);
+
+} // namespace common
+} // namespace codegen
@@ -0,0 +1,55 @@
+// This file is part of Desktop App Toolkit,
+// a set of libraries for developing nice desktop applications.
+//
+// For license and copyright information please follow this link:
+// https://github.com/desktop-app/legal/blob/master/LEGAL
+//
+#include "codegen/common/file_hash.h"
+
+#include <QtCore/QCryptographicHash>
+#include <QtCore/QDataStream>
+#include <QtCore/QDateTime>
+#include <QtCore/QFile>
+#include <QtCore/QFileInfo>
+
+namespace codegen {
+namespace common {
+
+QByteArray HashFileContent(const QString &path) {
+	auto file = QFile(path);
+	if (!file.open(QIODevice::ReadOnly)) {
+		return QByteArray();
+	}
+	auto hash = QCryptographicHash(QCryptographicHash::Md5);
+	if (!hash.addData(&file)) {
+		return QByteArray();
+	}
+	return hash.result();
+}
+
+FileStamp StampFile(const QString &path, const FileStamp &known) {
+	const auto info = QFileInfo(path);
+	if (!info.exists()) {
+		return FileStamp();
+	}
+	auto result = FileStamp();
+	result.modified = info.lastModified().toMSecsSinceEpoch();
+	result.size = info.size();
+	result.hash = (!known.hash.isEmpty()
+		&& known.modified == result.modified
+		&& known.size == result.size)
+		? known.hash
+		: HashFileContent(path);
+	return result;
+}
+
+QDataStream &operator<<(QDataStream &stream, const FileStamp &value) {
+	return stream << value.modified << value.size << value.hash;
+}
+
+QDataStream &operator>>(QDataStream &stream, FileStamp &value) {
+	return stream >> value.modified >> value.size >> value.hash;
+}
+
+} // namespace common
+} // namespace codegen
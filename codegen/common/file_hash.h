@@ -0,0 +1,36 @@
+// This file is part of Desktop App Toolkit,
+// a set of libraries for developing nice desktop applications.
+//
+// For license and copyright information please follow this link:
+// https://github.com/desktop-app/legal/blob/master/LEGAL
+//
+#pragma once
+
+#include <QtCore/QByteArray>
+#include <QtCore/QString>
+
+class QDataStream;
+
+namespace codegen {
+namespace common {
+
+// Returns a hash of the file content or an empty array if it can't be read.
+[[nodiscard]] QByteArray HashFileContent(const QString &path);
+
+// The content is hashed again only if the modification time or size change.
+struct FileStamp {
+	qint64 modified = 0;
+	qint64 size = 0;
+	QByteArray hash; // Empty if the file can't be read.
+};
+
+// Reuses the hash from "known" if the file wasn't touched since then.
+[[nodiscard]] FileStamp StampFile(
+	const QString &path,
+	const FileStamp &known = FileStamp());
+
+QDataStream &operator<<(QDataStream &stream, const FileStamp &value);
+QDataStream &operator>>(QDataStream &stream, FileStamp &value);
+
+} // namespace common
+} // namespace codegen
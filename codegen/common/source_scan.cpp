@@ -0,0 +1,561 @@
+// This file is part of Desktop App Toolkit,
+// a set of libraries for developing nice desktop applications.
+//
+// For license and copyright information please follow this link:
+// https://github.com/desktop-app/legal/blob/master/LEGAL
+//
+#include "codegen/common/source_scan.h"
+
+#include "codegen/common/logging.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <thread>
+#include <QtCore/QCryptographicHash>
+#include <QtCore/QDataStream>
+#include <QtCore/QDateTime>
+#include <QtCore/QDir>
+#include <QtCore/QDirIterator>
+#include <QtCore/QFile>
+#include <QtCore/QFileInfo>
+
+namespace codegen {
+namespace common {
+namespace {
+
+constexpr auto kSaneCount = qint32(1024 * 1024);
+constexpr auto kCompactFactor = 2;
+
+const auto kIncludeDirective = QByteArray("#include");
+
+enum class Record : quint8 {
+	State,
+	Scanned,
+	Removed,
+	Signature,
+	SignatureRemoved,
+};
+
+QDataStream &operator<<(QDataStream &stream, const ScannedSource &value) {
+	const auto list = [&](const std::vector<QByteArray> &values) {
+		stream << qint32(values.size());
+		for (const auto &entry : values) {
+			stream << entry;
+		}
+	};
+	stream << value.modified << value.size << value.hash;
+	list(value.tokens);
+	list(value.templates);
+	list(value.includes);
+	return stream;
+}
+
+QDataStream &operator>>(QDataStream &stream, ScannedSource &value) {
+	const auto list = [&](std::vector<QByteArray> &values) {
+		auto count = qint32(0);
+		stream >> count;
+		if (count < 0 || count > kSaneCount) {
+			stream.setStatus(QDataStream::ReadCorruptData);
+			return;
+		}
+		values.resize(count);
+		for (auto &entry : values) {
+			stream >> entry;
+		}
+	};
+	stream >> value.modified >> value.size >> value.hash;
+	list(value.tokens);
+	list(value.templates);
+	list(value.includes);
+	return stream;
+}
+
+[[nodiscard]] bool SameResults(
+		const ScannedSource &a,
+		const ScannedSource &b) {
+	return (a.tokens == b.tokens)
+		&& (a.templates == b.templates)
+		&& (a.includes == b.includes);
+}
+
+[[nodiscard]] bool Same(const ScannedSource &a, const ScannedSource &b) {
+	return (a.modified == b.modified)
+		&& (a.size == b.size)
+		&& (a.hash == b.hash)
+		&& SameResults(a, b);
+}
+
+[[nodiscard]] qsizetype Find(
+		const char *data,
+		qsizetype size,
+		qsizetype from,
+		char what) {
+	const auto found = static_cast<const char*>(
+		std::memchr(data + from, what, size - from));
+	return found ? (found - data) : -1;
+}
+
+// Looks for the first char with memchr() and compares the rest,
+// most of the content is skipped without looking at each byte.
+[[nodiscard]] qsizetype Find(
+		const char *data,
+		qsizetype size,
+		qsizetype from,
+		const QByteArray &what) {
+	const auto last = size - what.size();
+	while (!what.isEmpty() && from <= last) {
+		from = Find(data, last + 1, from, what[0]);
+		if (from < 0) {
+			return -1;
+		} else if (!std::memcmp(data + from, what.constData(), what.size())) {
+			return from;
+		}
+		++from;
+	}
+	return -1;
+}
+
+} // namespace
+
+bool IsIdentifierChar(char ch) {
+	return (ch >= 'a' && ch <= 'z')
+		|| (ch >= 'A' && ch <= 'Z')
+		|| (ch >= '0' && ch <= '9')
+		|| (ch == '_');
+}
+
+// Each kind of tokens is searched for separately from its own position,
+// so a match of one kind doesn't hide another.
+void ScanSource(
+		const char *data,
+		qsizetype size,
+		const ScanRules &rules,
+		ScannedSource &result) {
+	const auto &prefix = rules.tokenPrefix;
+	for (auto i = Find(data, size, 0, prefix); i >= 0;) {
+		if (i != 0 && IsIdentifierChar(data[i - 1])) {
+			i = Find(data, size, i + 1, prefix);
+			continue;
+		}
+		const auto from = i + prefix.size();
+		auto till = from;
+		while (till != size && IsIdentifierChar(data[till])) {
+			++till;
+		}
+		if (till != from) {
+			const auto begin = rules.keepPrefix ? i : from;
+			result.tokens.emplace_back(data + begin, till - begin);
+		}
+		i = Find(data, size, till, prefix);
+	}
+
+	const auto &start = rules.templateStart;
+	for (auto i = Find(data, size, 0, start); i >= 0;) {
+		const auto from = i + start.size();
+		const auto close = Find(data, size, from, '>');
+		if (close < 0) {
+			break;
+		}
+		result.templates.emplace_back(data + from, close - from);
+		i = Find(data, size, close + 1, start);
+	}
+
+	if (!rules.includes) {
+		return;
+	}
+	for (auto i = Find(data, size, 0, kIncludeDirective); i >= 0;) {
+		const auto directive = i;
+		i = Find(data, size, i + kIncludeDirective.size(), kIncludeDirective);
+
+		auto lineStart = directive;
+		while (lineStart > 0 && data[lineStart - 1] != '\n') {
+			--lineStart;
+		}
+		auto clean = true;
+		for (auto j = lineStart; j != directive; ++j) {
+			if (data[j] != ' ' && data[j] != '\t') {
+				clean = false;
+				break;
+			}
+		}
+		if (!clean) {
+			continue;
+		}
+		auto quote = directive + kIncludeDirective.size();
+		while (quote != size && (data[quote] == ' ' || data[quote] == '\t')) {
+			++quote;
+		}
+		if (quote == size || data[quote] != '"') {
+			continue;
+		}
+		const auto till = Find(data, size, quote + 1, '"');
+		if (till < 0) {
+			break;
+		}
+		result.includes.emplace_back(data + quote + 1, till - quote - 1);
+		i = Find(data, size, till + 1, kIncludeDirective);
+	}
+}
+
+std::vector<SourceFile> CollectSources(const QStringList &roots) {
+	auto result = std::vector<SourceFile>();
+	for (const auto &path : roots) {
+		const auto root = QDir(path).absolutePath();
+		auto iterator = QDirIterator(
+			root,
+			QDir::Files,
+			QDirIterator::Subdirectories);
+		while (iterator.hasNext()) {
+			const auto absolute = iterator.next();
+			if (!absolute.endsWith(".cpp")
+				&& !absolute.endsWith(".h")
+				&& !absolute.endsWith(".mm")) {
+				continue;
+			}
+			const auto info = iterator.fileInfo();
+			auto file = SourceFile();
+			file.absolute = absolute;
+			file.relative = absolute.mid(root.size() + 1);
+			file.unit = absolute.endsWith(".cpp") || absolute.endsWith(".mm");
+			file.scanned.modified = info.lastModified().toMSecsSinceEpoch();
+			file.scanned.size = info.size();
+			result.push_back(std::move(file));
+		}
+	}
+	std::sort(result.begin(), result.end(), [](const auto &a, const auto &b) {
+		return a.relative < b.relative;
+	});
+	return result;
+}
+
+bool ScanSources(
+		std::vector<SourceFile> &files,
+		const SourcesCache &cache,
+		const ScanRules &rules,
+		int errorCode,
+		bool *changed) {
+	auto pending = std::vector<int>();
+	auto previous = std::vector<const ScannedSource*>(files.size(), nullptr);
+	for (auto index = 0, count = int(files.size()); index != count; ++index) {
+		auto &file = files[index];
+		const auto i = cache.scanned.constFind(file.absolute);
+		if (i != cache.scanned.cend()
+			&& i->modified == file.scanned.modified
+			&& i->size == file.scanned.size) {
+			file.scanned = *i;
+			continue;
+		} else if (i != cache.scanned.cend()) {
+			previous[index] = &*i;
+		}
+		pending.push_back(index);
+	}
+
+	// Every worker writes only to the files it took, the results are
+	// checked afterwards in the sorted order to keep the output stable.
+	auto failed = std::vector<char>(files.size());
+	auto next = std::atomic<size_t>(0);
+	const auto worker = [&] {
+		while (true) {
+			const auto index = next++;
+			if (index >= pending.size()) {
+				return;
+			}
+			auto &file = files[pending[index]];
+			auto device = QFile(file.absolute);
+			if (!device.open(QIODevice::ReadOnly)) {
+				failed[pending[index]] = 1;
+				continue;
+			}
+
+			// A touched file with the same content keeps its scan results.
+			const auto was = previous[pending[index]];
+			const auto process = [&](const char *data, qsizetype size) {
+				file.scanned.hash = QCryptographicHash::hash(
+					QByteArray::fromRawData(data, size),
+					QCryptographicHash::Md5);
+				if (was && was->hash == file.scanned.hash) {
+					file.scanned.tokens = was->tokens;
+					file.scanned.templates = was->templates;
+					file.scanned.includes = was->includes;
+				} else {
+					ScanSource(data, size, rules, file.scanned);
+				}
+			};
+			const auto size = device.size();
+			if (const auto mapped = size ? device.map(0, size) : nullptr) {
+				process(reinterpret_cast<const char*>(mapped), size);
+			} else {
+				const auto content = device.readAll();
+				process(content.constData(), content.size());
+			}
+		}
+	};
+	const auto threadsCount = std::max(
+		std::min(size_t(std::thread::hardware_concurrency()), pending.size()),
+		size_t(1));
+	auto threads = std::vector<std::thread>();
+	for (auto i = size_t(1); i < threadsCount; ++i) {
+		threads.emplace_back(worker);
+	}
+	worker();
+	for (auto &thread : threads) {
+		thread.join();
+	}
+
+	for (const auto index : pending) {
+		const auto &file = files[index];
+		if (failed[index]) {
+			logError(errorCode, file.absolute)
+				<< "can not open the source file for reading";
+			return false;
+		}
+		const auto was = previous[index];
+		if (changed && (!was || !SameResults(*was, file.scanned))) {
+			*changed = true;
+		}
+	}
+	return true;
+}
+
+std::vector<std::vector<int>> ResolveIncludes(
+		const std::vector<SourceFile> &files,
+		const QStringList &roots) {
+	auto indices = QHash<QString, int>();
+	for (auto i = 0, count = int(files.size()); i != count; ++i) {
+		indices.insert(files[i].absolute, i);
+	}
+	auto absoluteRoots = QStringList();
+	for (const auto &root : roots) {
+		absoluteRoots.push_back(QDir(root).absolutePath());
+	}
+	auto result = std::vector<std::vector<int>>(files.size());
+	for (auto index = 0, count = int(files.size()); index != count; ++index) {
+		const auto &file = files[index];
+		const auto dir = file.absolute.left(file.absolute.lastIndexOf('/'));
+		auto bases = QStringList{ dir };
+		bases.append(absoluteRoots);
+		for (const auto &include : file.scanned.includes) {
+			const auto relative = QString::fromUtf8(include);
+			const auto exact = !relative.contains("..")
+				&& !relative.contains("./");
+			for (const auto &base : std::as_const(bases)) {
+				const auto joined = base + '/' + relative;
+				const auto i = indices.constFind(
+					exact ? joined : QDir::cleanPath(joined));
+				if (i != indices.cend()) {
+					result[index].push_back(*i);
+					break;
+				}
+			}
+		}
+	}
+	return result;
+}
+
+// Tarjan's algorithm without recursion.
+IncludeComponents CondenseIncludes(
+		const std::vector<std::vector<int>> &included) {
+	const auto count = int(included.size());
+	auto result = IncludeComponents();
+	result.index.assign(count, -1);
+	auto order = std::vector<int>(count, -1);
+	auto low = std::vector<int>(count, 0);
+	auto onStack = std::vector<char>(count, 0);
+	auto stack = std::vector<int>();
+	auto calls = std::vector<std::pair<int, int>>(); // file, next edge
+	auto counter = 0;
+	for (auto root = 0; root != count; ++root) {
+		if (order[root] >= 0) {
+			continue;
+		}
+		calls.emplace_back(root, 0);
+		while (!calls.empty()) {
+			auto &[file, edge] = calls.back();
+			if (!edge && order[file] < 0) {
+				order[file] = low[file] = counter++;
+				stack.push_back(file);
+				onStack[file] = 1;
+			}
+			const auto &edges = included[file];
+			if (edge != int(edges.size())) {
+				const auto to = edges[edge++];
+				if (order[to] < 0) {
+					calls.emplace_back(to, 0);
+				} else if (onStack[to]) {
+					low[file] = std::min(low[file], order[to]);
+				}
+				continue;
+			}
+			const auto done = file;
+			calls.pop_back();
+			if (!calls.empty()) {
+				const auto parent = calls.back().first;
+				low[parent] = std::min(low[parent], low[done]);
+			}
+			if (low[done] != order[done]) {
+				continue;
+			}
+			auto &list = result.files.emplace_back();
+			while (true) {
+				const auto member = stack.back();
+				stack.pop_back();
+				onStack[member] = 0;
+				result.index[member] = result.count;
+				list.push_back(member);
+				if (member == done) {
+					break;
+				}
+			}
+			++result.count;
+		}
+	}
+	return result;
+}
+
+Bits EmptyBits(int count) {
+	return Bits((count + 63) / 64, 0);
+}
+
+void SetBit(Bits &bits, int index) {
+	bits[index / 64] |= (quint64(1) << (index % 64));
+}
+
+void UniteBits(Bits &to, const Bits &from) {
+	for (auto i = 0, count = int(to.size()); i != count; ++i) {
+		to[i] |= from[i];
+	}
+}
+
+std::vector<int> BitsList(const Bits &bits) {
+	auto result = std::vector<int>();
+	for (auto i = 0, count = int(bits.size()); i != count; ++i) {
+		for (auto word = bits[i]; word != 0; word &= (word - 1)) {
+			auto bit = 0;
+			while (!(word & (quint64(1) << bit))) {
+				++bit;
+			}
+			result.push_back(i * 64 + bit);
+		}
+	}
+	return result;
+}
+
+SourcesCache ReadSourcesCache(const QString &path, quint32 version) {
+	auto result = SourcesCache();
+	auto file = QFile(path);
+	if (!file.open(QIODevice::ReadOnly)) {
+		return result;
+	}
+	auto stream = QDataStream(&file);
+	auto stored = quint32(0);
+	stream >> stored;
+	if (stored != version) {
+		return SourcesCache();
+	}
+	auto name = QString();
+	while (!stream.atEnd()) {
+		auto type = quint8(0);
+		stream >> type;
+		switch (Record(type)) {
+		case Record::State:
+			stream >> result.state;
+			break;
+		case Record::Scanned: {
+			auto scanned = ScannedSource();
+			stream >> name >> scanned;
+			result.scanned.insert(name, std::move(scanned));
+		} break;
+		case Record::Removed:
+			stream >> name;
+			result.scanned.remove(name);
+			break;
+		case Record::Signature: {
+			auto signature = QByteArray();
+			stream >> name >> signature;
+			result.signatures.insert(name, signature);
+		} break;
+		case Record::SignatureRemoved:
+			stream >> name;
+			result.signatures.remove(name);
+			break;
+		default:
+			stream.setStatus(QDataStream::ReadCorruptData);
+			break;
+		}
+		if (stream.status() != QDataStream::Ok) {
+			return SourcesCache();
+		}
+		++result.records;
+	}
+	return result;
+}
+
+void WriteSourcesCache(
+		const QString &path,
+		quint32 version,
+		const SourcesCache &was,
+		const SourcesCache &now) {
+	auto changes = QByteArray();
+	auto count = 0;
+	const auto writeChanges = [&](const SourcesCache &was) {
+		auto stream = QDataStream(&changes, QIODevice::WriteOnly);
+		if (was.state != now.state) {
+			stream << quint8(Record::State) << now.state;
+			++count;
+		}
+		for (auto i = now.scanned.cbegin(); i != now.scanned.cend(); ++i) {
+			const auto j = was.scanned.constFind(i.key());
+			if (j == was.scanned.cend() || !Same(*i, *j)) {
+				stream << quint8(Record::Scanned) << i.key() << *i;
+				++count;
+			}
+		}
+		for (auto i = was.scanned.cbegin(); i != was.scanned.cend(); ++i) {
+			if (!now.scanned.contains(i.key())) {
+				stream << quint8(Record::Removed) << i.key();
+				++count;
+			}
+		}
+		for (auto i = now.signatures.cbegin(); i != now.signatures.cend(); ++i) {
+			const auto j = was.signatures.constFind(i.key());
+			if (j == was.signatures.cend() || *i != *j) {
+				stream << quint8(Record::Signature) << i.key() << *i;
+				++count;
+			}
+		}
+		for (auto i = was.signatures.cbegin(); i != was.signatures.cend(); ++i) {
+			if (!now.signatures.contains(i.key())) {
+				stream << quint8(Record::SignatureRemoved) << i.key();
+				++count;
+			}
+		}
+	};
+	writeChanges(was);
+	if (!count) {
+		return;
+	}
+	const auto live = 1 + now.scanned.size() + now.signatures.size();
+	const auto append = (was.records > 0)
+		&& (was.records + count <= kCompactFactor * live);
+	if (!append) {
+		changes.clear();
+		count = 0;
+		writeChanges(SourcesCache());
+	}
+	QFileInfo(path).dir().mkpath(".");
+	auto file = QFile(path);
+	if (!file.open(append
+		? (QIODevice::WriteOnly | QIODevice::Append)
+		: QIODevice::WriteOnly)) {
+		return;
+	}
+	if (!append) {
+		auto stream = QDataStream(&file);
+		stream << version;
+	}
+	file.write(changes);
+}
+
+} // namespace common
+} // namespace codegen
@@ -0,0 +1,116 @@
+// This file is part of Desktop App Toolkit,
+// a set of libraries for developing nice desktop applications.
+//
+// For license and copyright information please follow this link:
+// https://github.com/desktop-app/legal/blob/master/LEGAL
+//
+#pragma once
+
+#include <vector>
+#include <QtCore/QByteArray>
+#include <QtCore/QHash>
+#include <QtCore/QString>
+#include <QtCore/QStringList>
+
+namespace codegen {
+namespace common {
+
+// What to look for in the sources. A token is an identifier following
+// the "tokenPrefix" which itself is not a part of another identifier.
+struct ScanRules {
+	QByteArray tokenPrefix;
+	bool keepPrefix = false;
+
+	// Collects contents of "<templateStart>...>", like "phrase<".
+	QByteArray templateStart;
+
+	// Collects paths of the '#include "..."' directives.
+	bool includes = false;
+};
+
+struct ScannedSource {
+	qint64 modified = 0;
+	qint64 size = 0;
+	QByteArray hash;
+	std::vector<QByteArray> tokens;
+	std::vector<QByteArray> templates;
+	std::vector<QByteArray> includes;
+};
+
+struct SourceFile {
+	QString absolute;
+	QString relative;
+	bool unit = false;
+	ScannedSource scanned;
+};
+
+// Scan results by absolute path, an opaque "state" of the generated
+// inputs and signatures of the written outputs by their relative path.
+struct SourcesCache {
+	QByteArray state;
+	QHash<QString, ScannedSource> scanned;
+	QHash<QString, QByteArray> signatures;
+	int records = 0;
+};
+
+[[nodiscard]] bool IsIdentifierChar(char ch);
+
+// Finds the tokens of each kind in one sweep over the content.
+void ScanSource(
+	const char *data,
+	qsizetype size,
+	const ScanRules &rules,
+	ScannedSource &result);
+
+// Lists .cpp/.h/.mm files in the roots sorted by their relative paths,
+// with the modification time and size filled in "scanned".
+[[nodiscard]] std::vector<SourceFile> CollectSources(const QStringList &roots);
+
+// Takes the results of the files with the same modification time and size
+// or content from the cache and scans the others on worker threads.
+// Sets "changed" if the results of any file differ from the cached ones.
+// Logs an error with "errorCode" and fails if a file can't be read.
+[[nodiscard]] bool ScanSources(
+	std::vector<SourceFile> &files,
+	const SourcesCache &cache,
+	const ScanRules &rules,
+	int errorCode,
+	bool *changed = nullptr);
+
+// Indices of the files included by each file, resolved relative to
+// the including file or one of the roots.
+[[nodiscard]] std::vector<std::vector<int>> ResolveIncludes(
+	const std::vector<SourceFile> &files,
+	const QStringList &roots);
+
+// Strongly connected components of the include graph. They are numbered
+// in the order they are completed, so all the components included from
+// a component have smaller numbers than it has.
+struct IncludeComponents {
+	std::vector<int> index; // file -> component
+	std::vector<std::vector<int>> files; // component -> files
+	int count = 0;
+};
+[[nodiscard]] IncludeComponents CondenseIncludes(
+	const std::vector<std::vector<int>> &included);
+
+using Bits = std::vector<quint64>;
+[[nodiscard]] Bits EmptyBits(int count);
+void SetBit(Bits &bits, int index);
+void UniteBits(Bits &to, const Bits &from);
+[[nodiscard]] std::vector<int> BitsList(const Bits &bits);
+
+// The cache is a log of records, a later record replaces an earlier one.
+// Changes are appended, the file is rewritten when the records of the
+// removed or replaced entries outnumber the live ones.
+[[nodiscard]] SourcesCache ReadSourcesCache(
+	const QString &path,
+	quint32 version);
+void WriteSourcesCache(
+	const QString &path,
+	quint32 version,
+	const SourcesCache &was,
+	const SourcesCache &now);
+
+} // namespace common
+} // namespace codegen
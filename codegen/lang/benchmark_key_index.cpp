@@ -0,0 +1,94 @@
+// This file is part of Desktop App Toolkit,
+// a set of libraries for developing nice desktop applications.
+//
+// For license and copyright information please follow this link:
+// https://github.com/desktop-app/legal/blob/master/LEGAL
+//
+// Built by benchmark_key_index.sh with the Lang::GetKeyIndex() taken
+// from a generated lang_auto.cpp, without Qt and lib_lang.
+//
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+
+using uchar = unsigned char;
+using ushort = unsigned short;
+using quint32 = std::uint32_t;
+using qsizetype = std::ptrdiff_t;
+
+class QLatin1String {
+public:
+	QLatin1String(const char *data, qsizetype size)
+	: _data(data)
+	, _size(size) {
+	}
+
+	[[nodiscard]] const char *data() const {
+		return _data;
+	}
+	[[nodiscard]] qsizetype size() const {
+		return _size;
+	}
+
+private:
+	const char *_data = nullptr;
+	qsizetype _size = 0;
+
+};
+
+#include "lang_auto_counts.h"
+
+namespace Lang {
+
+#include "key_index.h"
+
+} // namespace Lang
+
+int main(int argc, char *argv[]) {
+	if (argc != 3) {
+		std::fprintf(stderr, "Usage: %s <keys> <repeats>\n", argv[0]);
+		return 1;
+	}
+	auto input = std::ifstream(argv[1]);
+	auto keys = std::vector<std::string>();
+	for (auto line = std::string(); std::getline(input, line);) {
+		keys.push_back(line);
+	}
+	const auto repeats = std::atoi(argv[2]);
+	if (keys.empty() || repeats <= 0) {
+		std::fprintf(stderr, "No keys or bad repeats count.\n");
+		return 1;
+	}
+
+	// Every key is looked up once per repeat, in the lang.strings order,
+	// the same way a language pack is loaded.
+	auto checksum = std::uint64_t();
+	auto found = 0;
+	const auto start = std::chrono::steady_clock::now();
+	for (auto repeat = 0; repeat != repeats; ++repeat) {
+		for (const auto &key : keys) {
+			const auto index = Lang::GetKeyIndex(
+				QLatin1String(key.data(), qsizetype(key.size())));
+			checksum = checksum * 31 + index;
+			if (!repeat && index != Lang::kKeysCount) {
+				++found;
+			}
+		}
+	}
+	const auto elapsed = std::chrono::steady_clock::now() - start;
+	const auto ns = std::chrono::duration<double, std::nano>(elapsed).count();
+	std::printf(
+		"%d of %d keys found, %.1f ns per lookup, %.3f ms per pack, "
+		"checksum %016llx\n",
+		found,
+		int(keys.size()),
+		ns / (double(keys.size()) * repeats),
+		ns / repeats / 1e6,
+		(unsigned long long)checksum);
+	return 0;
+}
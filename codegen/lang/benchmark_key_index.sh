@@ -0,0 +1,59 @@
+#!/bin/sh
+# This file is part of Desktop App Toolkit,
+# a set of libraries for developing nice desktop applications.
+#
+# For license and copyright information please follow this link:
+# https://github.com/desktop-app/legal/blob/master/LEGAL
+#
+# Times Lang::GetKeyIndex() generated as a switch trie and with
+# --perfect-hash by looking up every key of the lang.strings in order.
+# Only the generated lookup is compiled, with benchmark_key_index.cpp.
+#
+# Usage: benchmark_key_index.sh <path to codegen_lang> <lang.strings> [repeats]
+
+set -e
+
+if [ "$#" -lt 2 ] || [ "$#" -gt 3 ]; then
+	echo "Usage: $0 <path to codegen_lang> <lang.strings> [repeats]" >&2
+	exit 1
+fi
+codegen=$1
+strings=$2
+repeats=${3:-200}
+here=$(cd "$(dirname "$0")" && pwd)
+cxx=${CXX:-c++}
+work=$(mktemp -d)
+trap 'rm -rf "$work"' EXIT
+
+sed -n 's/^"\([^"]*\)"[ 	]*=.*/\1/p' "$strings" > "$work/keys.txt"
+
+# The perfect hash helpers are in an anonymous namespace before the
+# lookup, the benchmark puts them together in namespace Lang.
+extract() {
+	awk '
+		/^\/\/ Must be the same as PerfectHash|^ushort GetKeyIndex\(/ {
+			copy = 1
+		}
+		copy && /^(namespace \{|\} \/\/ namespace)$/ { next }
+		copy { print }
+		started && /^}$/ { exit }
+		/^ushort GetKeyIndex\(/ { started = 1 }
+	' "$1"
+}
+
+run() {
+	name=$1
+	shift
+	mkdir -p "$work/$name"
+	"$codegen" -o "$work/$name" "$@" "$strings"
+	extract "$work/$name/lang_auto.cpp" > "$work/$name/key_index.h"
+	"$cxx" -std=c++17 -O2 \
+		-I "$work/$name" \
+		-o "$work/$name/benchmark" \
+		"$here/benchmark_key_index.cpp"
+	printf '%-14s' "$name:"
+	"$work/$name/benchmark" "$work/keys.txt" "$repeats"
+}
+
+run trie
+run perfect-hash --perfect-hash
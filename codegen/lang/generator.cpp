@@ -6,14 +6,19 @@
 //
 #include "codegen/lang/generator.h"
 
+#include "base/crc32hash.h"
+
 #include <algorithm>
+#include <cstring>
 #include <limits>
 #include <memory>
+#include <optional>
 #include <functional>
+#include <QtCore/QCryptographicHash>
 #include <QtCore/QDir>
 #include <QtCore/QFile>
 #include <QtCore/QSet>
-#include <QtCore/QTextStream>
+#include <QtCore/QSysInfo>
 #include <QtGui/QImage>
 #include <QtGui/QPainter>
 
@@ -23,21 +28,303 @@ namespace {
 
 constexpr int kErrorTooManyKeys = 841;
 constexpr int kErrorTooManyTags = 842;
+constexpr int kErrorPerfectHashFailed = 843;
+constexpr int kErrorCantWriteData = 844;
+constexpr int kErrorBadPackTag = 845;
+constexpr int kErrorBadPackLayout = 846;
+
+// Language pack: kPackHeaderFields quint32 values, then the offsets, the
+// sizes and the presence bits of all key slots, then the char16_t data.
+// The layout hash in the header must be equal to Lang::kPackLayoutHash.
+constexpr auto kPackMagic = quint32(0x474E4C54); // "TLNG"
+constexpr auto kPackVersion = quint32(2);
+constexpr auto kPackHeaderFields = 9;
 
 constexpr auto kIndexLimit = std::numeric_limits<ushort>::max();
 
-struct Slot {
-	int start = 0;
+using Slot = PackLayout::Slot;
+
+// The .indices file has a "name\tstart\tsize" line for every key slot.
+[[nodiscard]] std::map<QString, Slot> ParseIndices(const QByteArray &content) {
+	auto result = std::map<QString, Slot>();
+	for (const auto &line : content.split('\n')) {
+		const auto parts = QString::fromUtf8(line).split('\t');
+		if (parts.size() != 3) {
+			continue;
+		}
+		const auto start = parts[1].toInt();
+		const auto size = parts[2].toInt();
+		if (size <= 0 || start < 0) {
+			continue;
+		}
+		result.emplace(parts[0], Slot{ start, size });
+	}
+	return result;
+}
+
+[[nodiscard]] QByteArray SerializeIndices(const std::map<QString, Slot> &slots) {
+	auto result = QByteArray();
+	for (const auto &[name, slot] : slots) {
+		result += name.toUtf8()
+			+ '\t' + QByteArray::number(slot.start)
+			+ '\t' + QByteArray::number(slot.size)
+			+ '\n';
+	}
+	return result;
+}
+
+[[nodiscard]] QByteArray SerializeTags(const std::vector<LangPack::Tag> &tags) {
+	auto result = QByteArray();
+	for (const auto &tag : tags) {
+		result += tag.tag.toUtf8() + '\n';
+	}
+	return result;
+}
+
+[[nodiscard]] quint32 LayoutHash(
+		const std::map<QString, Slot> &slots,
+		const std::vector<LangPack::Tag> &tags) {
+	const auto layout = SerializeIndices(slots) + '|' + SerializeTags(tags);
+	return quint32(base::crc32(layout.constData(), layout.size()));
+}
+
+// Average keys in a bucket of the perfect hash, and the search limits.
+constexpr auto kPerfectHashBucketSize = 4;
+constexpr auto kPerfectHashMaxSeed = quint32(1) << 20;
+constexpr auto kPerfectHashAttempts = 16;
+
+// Must be the same as the generated KeyHash() in the source.
+[[nodiscard]] quint32 PerfectHash(const QByteArray &key, quint32 seed) {
+	auto result = seed ^ quint32(0x811C9DC5U);
+	for (const auto ch : key) {
+		result ^= uchar(ch);
+		result *= quint32(0x01000193U);
+	}
+	result ^= result >> 16;
+	result *= quint32(0x85EBCA6BU);
+	result ^= result >> 13;
+	result *= quint32(0xC2B2AE35U);
+	result ^= result >> 16;
+	return result;
+}
+
+struct PerfectHashTable {
+	quint32 seed = 0;
+	std::vector<quint32> seeds; // bucket -> displacement seed
+	std::vector<int> slots; // slot -> key
+};
+
+// Hash and displace: keys are split to buckets by the first hash,
+// then for every bucket, largest first, a seed is found that puts
+// all its keys to the free slots, there are as many slots as keys.
+[[nodiscard]] std::optional<PerfectHashTable> BuildPerfectHash(
+		const std::vector<QByteArray> &keys) {
+	const auto count = int(keys.size());
+	const auto buckets = std::max(
+		(count + kPerfectHashBucketSize - 1) / kPerfectHashBucketSize,
+		1);
+	for (auto attempt = 1; attempt <= kPerfectHashAttempts; ++attempt) {
+		auto result = PerfectHashTable{ quint32(attempt) };
+		auto bucketKeys = std::vector<std::vector<int>>(buckets);
+		for (auto i = 0; i != count; ++i) {
+			bucketKeys[PerfectHash(keys[i], result.seed) % buckets].push_back(i);
+		}
+		auto order = std::vector<int>(buckets);
+		for (auto i = 0; i != buckets; ++i) {
+			order[i] = i;
+		}
+		std::stable_sort(order.begin(), order.end(), [&](int a, int b) {
+			return bucketKeys[a].size() > bucketKeys[b].size();
+		});
+
+		result.seeds.assign(buckets, 0);
+		result.slots.assign(count, -1);
+		auto placed = std::vector<int>();
+		const auto place = [&](int bucket) {
+			const auto &list = bucketKeys[bucket];
+			for (auto seed = quint32(1); seed != kPerfectHashMaxSeed; ++seed) {
+				placed.clear();
+				for (const auto key : list) {
+					const auto slot = int(PerfectHash(keys[key], seed) % count);
+					if (result.slots[slot] >= 0
+						|| std::find(placed.begin(), placed.end(), slot) != placed.end()) {
+						break;
+					}
+					placed.push_back(slot);
+				}
+				if (placed.size() == list.size()) {
+					for (auto i = 0, size = int(list.size()); i != size; ++i) {
+						result.slots[placed[i]] = list[i];
+					}
+					result.seeds[bucket] = seed;
+					return true;
+				}
+			}
+			return false;
+		};
+		auto failed = false;
+		for (const auto bucket : order) {
+			if (bucketKeys[bucket].empty()) {
+				break;
+			} else if (!place(bucket)) {
+				failed = true;
+				break;
+			}
+		}
+		if (!failed) {
+			return result;
+		}
+	}
+	return std::nullopt;
+}
+
+struct OffsetType {
+	QString name;
 	int size = 0;
 };
 
+const auto kWordType = OffsetType{ "quint32", 4 };
+
+// The narrowest type that holds all the offsets or sizes of the values.
+[[nodiscard]] OffsetType ChooseOffsetType(const std::vector<quint32> &list) {
+	const auto max = list.empty()
+		? quint32(0)
+		: *std::max_element(list.begin(), list.end());
+	if (max <= std::numeric_limits<uchar>::max()) {
+		return { "uchar", 1 };
+	} else if (max <= std::numeric_limits<ushort>::max()) {
+		return { "ushort", 2 };
+	}
+	return { "quint32", 4 };
+}
+
+// In the .data file the offsets go first, then the sizes and then the
+// char16_t values, each part starting at a four bytes boundary.
+[[nodiscard]] int AlignedSize(int size) {
+	return (size + 3) & ~3;
+}
+
+// Values are written in the host byte order, the generated source checks
+// that the target has the same one.
+void AppendList(
+		QByteArray &blob,
+		const std::vector<quint32> &list,
+		const OffsetType &type) {
+	const auto from = blob.size();
+	blob.resize(from + AlignedSize(type.size * int(list.size())));
+	std::fill(blob.begin() + from, blob.end(), char(0));
+	for (auto i = 0, count = int(list.size()); i != count; ++i) {
+		const auto to = blob.data() + from + i * type.size;
+		if (type.size == 1) {
+			*reinterpret_cast<uchar*>(to) = uchar(list[i]);
+		} else if (type.size == 2) {
+			const auto value = ushort(list[i]);
+			std::memcpy(to, &value, sizeof(value));
+		} else {
+			std::memcpy(to, &list[i], sizeof(list[i]));
+		}
+	}
+}
+
+void AppendData(QByteArray &blob, const std::vector<char16_t> &data) {
+	blob.append(
+		reinterpret_cast<const char*>(data.data()),
+		int(data.size() * sizeof(char16_t)));
+}
+
+[[nodiscard]] bool WriteIfChanged(const QString &path, const QByteArray &blob) {
+	auto file = QFile(path);
+	if (file.open(QIODevice::ReadOnly) && file.readAll() == blob) {
+		return true;
+	}
+	file.close();
+	if (!file.open(QIODevice::WriteOnly)
+		|| file.write(blob) != blob.size()) {
+		common::logError(kErrorCantWriteData, "Command Line")
+			<< "could not write '" << path.toStdString() << "'";
+		return false;
+	}
+	return true;
+}
+
+struct DefaultValues {
+	std::vector<char16_t> data;
+	std::vector<quint32> offsets;
+	std::vector<quint32> sizes;
+};
+
+// Values that are suffixes of other values, including the same values,
+// point inside the data of those values instead of having a copy.
+[[nodiscard]] DefaultValues PackDefaultValues(
+		const std::vector<const LangPack::Entry*> &byIndex) {
+	const auto count = int(byIndex.size());
+	const auto value = [&](int index) {
+		return byIndex[index] ? byIndex[index]->value : QString();
+	};
+	const auto reversed = [&](int index) {
+		auto result = value(index);
+		std::reverse(result.begin(), result.end());
+		return result;
+	};
+
+	// Sorted by the reversed values a suffix goes right before the
+	// values that end with it, so it is shared with the last of them.
+	auto keys = std::vector<std::pair<QString, int>>();
+	keys.reserve(count);
+	for (auto i = 0; i != count; ++i) {
+		keys.emplace_back(reversed(i), i);
+	}
+	std::sort(keys.begin(), keys.end());
+	auto owners = std::vector<int>(count);
+	for (auto i = count; i != 0;) {
+		--i;
+		const auto index = keys[i].second;
+		owners[index] = (i + 1 != count
+			&& keys[i + 1].first.startsWith(keys[i].first))
+			? owners[keys[i + 1].second]
+			: index;
+	}
+
+	auto result = DefaultValues();
+	result.offsets.resize(count);
+	result.sizes.resize(count);
+	for (auto i = 0; i != count; ++i) {
+		const auto owner = owners[i];
+		if (owner == i) {
+			result.offsets[i] = quint32(result.data.size());
+			for (const auto ch : value(i)) {
+				result.data.push_back(char16_t(ch.unicode()));
+			}
+		}
+		result.sizes[i] = quint32(value(i).size());
+	}
+	for (auto i = 0; i != count; ++i) {
+		const auto owner = owners[i];
+		result.offsets[i] = result.offsets[owner]
+			+ result.sizes[owner]
+			- result.sizes[i];
+	}
+	return result;
+}
+
+[[nodiscard]] QString EscapeString(QString value) {
+	return value.replace('\\', "\\\\").replace('"', "\\\"");
+}
+
 } // namespace
 
-Generator::Generator(const LangPack &langpack, const QString &destBasePath, const common::ProjectInfo &project)
+Generator::Generator(
+	const LangPack &langpack,
+	const QString &destBasePath,
+	const common::ProjectInfo &project,
+	bool perfectHash,
+	bool binaryData)
 : langpack_(langpack)
 , basePath_(destBasePath)
 , baseName_(QFileInfo(basePath_).baseName())
-, project_(project) {
+, project_(project)
+, perfectHash_(perfectHash)
+, binaryData_(binaryData) {
 	allocateIndices();
 	saveTagOrder();
 	collectDeclarations();
@@ -46,36 +333,22 @@ Generator::Generator(const LangPack &langpack, const QString &destBasePath, cons
 void Generator::saveTagOrder() {
 	auto file = QFile(basePath_ + ".tags");
 	if (file.open(QIODevice::WriteOnly)) {
-		auto stream = QTextStream(&file);
-		for (const auto &tag : langpack_.tags) {
-			stream << tag.tag << '\n';
-		}
+		file.write(SerializeTags(langpack_.tags));
 	}
 }
 
 void Generator::allocateIndices() {
 	const auto path = basePath_ + ".indices";
 	auto known = std::map<QString, Slot>();
-	auto next = 0;
-
 	auto reading = QFile(path);
 	if (reading.open(QIODevice::ReadOnly)) {
-		auto stream = QTextStream(&reading);
-		while (!stream.atEnd()) {
-			const auto parts = stream.readLine().split('\t');
-			if (parts.size() != 3) {
-				continue;
-			}
-			const auto start = parts[1].toInt();
-			const auto size = parts[2].toInt();
-			if (size <= 0 || start < 0) {
-				continue;
-			}
-			known.emplace(parts[0], Slot{ start, size });
-			next = std::max(next, start + size);
-		}
+		known = ParseIndices(reading.readAll());
 		reading.close();
 	}
+	auto next = 0;
+	for (const auto &[name, slot] : known) {
+		next = std::max(next, slot.start + slot.size);
+	}
 
 	indices_.assign(langpack_.entries.size(), -1);
 	for (auto i = 0, count = int(langpack_.entries.size()); i != count; ++i) {
@@ -108,11 +381,9 @@ void Generator::allocateIndices() {
 
 	auto writing = QFile(path);
 	if (writing.open(QIODevice::WriteOnly)) {
-		auto stream = QTextStream(&writing);
-		for (const auto &[name, slot] : known) {
-			stream << name << '\t' << slot.start << '\t' << slot.size << '\n';
-		}
+		writing.write(SerializeIndices(known));
 	}
+	layoutHash_ = LayoutHash(known, langpack_.tags);
 }
 
 void Generator::collectDeclarations() {
@@ -178,6 +449,11 @@ bool Generator::writeCounts() {
 \n\
 inline constexpr auto kTagsCount = ushort(" << langpack_.tags.size() << ");\n\
 inline constexpr auto kKeysCount = ushort(" << keysCount_ << ");\n\
+\n\
+// Language packs compiled for other key slots or tags are rejected.\n\
+inline constexpr auto kPackLayoutHash = quint32(0x"
+		<< QString::number(layoutHash_, 16).toUpper()
+		<< "U);\n\
 \n";
 	file.popNamespace();
 	return file.finalize();
@@ -342,11 +618,23 @@ struct phrase<" + tags.join(", ") + "> {\n\
 }
 
 bool Generator::writeSource() {
+	auto byIndex = std::vector<const LangPack::Entry*>(keysCount_, nullptr);
+	for (auto i = 0, count = int(langpack_.entries.size()); i != count; ++i) {
+		byIndex[indices_[i]] = &langpack_.entries[i];
+	}
+	const auto values = PackDefaultValues(byIndex);
+
 	source_ = std::make_unique<common::CppFile>(basePath_ + ".cpp", project_);
 
 	source_->include("lang/lang_keys.h")
-		.include(baseName_ + "_counts.h")
-		.pushNamespace("Lang")
+		.include(baseName_ + "_counts.h");
+	if (binaryData_ && !writeDefaultDataBlob(
+			values.data,
+			values.offsets,
+			values.sizes)) {
+		return false;
+	}
+	source_->pushNamespace("Lang")
 		.pushNamespace();
 
 	source_->stream() << "\
@@ -354,57 +642,23 @@ static_assert(sizeof(QChar) == sizeof(char16_t));\n\
 static_assert(alignof(QChar) == alignof(char16_t));\n\
 \n";
 
-	auto byIndex = std::vector<const LangPack::Entry*>(keysCount_, nullptr);
-	for (auto i = 0, count = int(langpack_.entries.size()); i != count; ++i) {
-		byIndex[indices_[i]] = &langpack_.entries[i];
-	}
-
-	source_->stream() << "\
-const char16_t DefaultData[] = {";
-	auto count = 0;
-	auto fulllength = 0;
-	for (const auto entry : byIndex) {
-		if (!entry) {
-			continue;
-		}
-		for (auto ch : entry->value) {
-			if (fulllength > 0) source_->stream() << ",";
-			if (!count++) {
-				source_->stream() << "\n";
-			} else {
-				if (count == 12) {
-					count = 0;
-				}
-				source_->stream() << " ";
-			}
-			source_->stream() << "0x" << QString::number(ch.unicode(), 16);
-			++fulllength;
-		}
-	}
-	source_->stream() << " };\n\
-\n\
-int Offsets[] = {";
-	count = 0;
-	auto offset = 0;
-	auto written = 0;
-	auto writeOffset = [this, &count, &offset, &written] {
-		if (written++ > 0) source_->stream() << ",";
-		if (!count++) {
-			source_->stream() << "\n";
-		} else {
-			if (count == 12) {
-				count = 0;
-			}
-			source_->stream() << " ";
-		}
-		source_->stream() << offset;
-	};
-	for (const auto entry : byIndex) {
-		writeOffset();
-		offset += entry ? entry->value.size() : 0;
+	if (binaryData_) {
+		const auto offsetType = ChooseOffsetType(values.offsets);
+		const auto sizeType = ChooseOffsetType(values.sizes);
+		const auto sizesOffset = AlignedSize(
+			offsetType.size * int(values.offsets.size()));
+		const auto dataOffset = sizesOffset
+			+ AlignedSize(sizeType.size * int(values.sizes.size()));
+		source_->stream() << "\
+const auto Offsets = reinterpret_cast<const " << offsetType.name << "*>(\n\
+	" << baseName_ << "_data);\n\
+const auto Sizes = reinterpret_cast<const " << sizeType.name << "*>(\n\
+	" << baseName_ << "_data + " << sizesOffset << ");\n\
+const auto DefaultData = reinterpret_cast<const char16_t*>(\n\
+	" << baseName_ << "_data + " << dataOffset << ");\n";
+	} else {
+		writeDefaultDataArrays(values.data, values.offsets, values.sizes);
 	}
-	writeOffset();
-	source_->stream() << " };\n";
 	source_->popNamespace().stream() << "\
 \n\
 ushort GetTagIndex(QLatin1String tag) {\n\
@@ -422,10 +676,7 @@ ushort GetTagIndex(QLatin1String tag) {\n\
 
 	source_->stream() << "\
 }\n\
-\n\
-ushort GetKeyIndex(QLatin1String key) {\n\
-	auto size = key.size();\n\
-	auto data = key.data();\n";
+\n";
 
 	auto indices = std::map<QString, QString>();
 	for (auto i = 0, total = int(langpack_.entries.size()); i != total; ++i) {
@@ -459,68 +710,479 @@ ushort GetKeyIndex(QLatin1String key) {\n\
 		}
 	}
 
-	writeSetSearch(keysSet, [&](const QString &key) {
+	const auto keyIndex = [&](const QString &key) {
 		auto it = taggedKeys.find(key);
 		const auto name = (it != taggedKeys.end()) ? it->second : key;
 		return indexOfKey(name);
-	}, "kKeysCount");
-	header_->popNamespace().newline();
-
-	source_->stream() << "\
+	};
+	if (perfectHash_) {
+		auto keys = std::vector<std::pair<QString, QString>>();
+		keys.reserve(keysSet.size());
+		for (const auto &key : keysSet) {
+			keys.emplace_back(key, keyIndex(key));
+		}
+		if (!writeKeyIndexPerfectHash(keys)) {
+			return false;
+		}
+	} else {
+		source_->stream() << "\
+ushort GetKeyIndex(QLatin1String key) {\n\
+	auto size = key.size();\n\
+	auto data = key.data();\n";
+		writeSetSearch(keysSet, keyIndex, "kKeysCount");
+		source_->stream() << "\
 }\n\
-\n\
-bool IsTagReplaced(ushort key, ushort tag) {\n\
-	switch (key) {\n";
+\n";
+	}
+	header_->popNamespace().newline();
 
-	auto lastWrittenPluralEntry = QString();
-	for (auto &entry : langpack_.entries) {
+	// Keys with the same tags share one bitset of kTagWords words,
+	// the set with index zero is the empty one.
+	auto tagIndices = std::map<QString, int>();
+	for (auto i = 0, count = int(langpack_.tags.size()); i != count; ++i) {
+		tagIndices.emplace(langpack_.tags[i].tag, i);
+	}
+	const auto tagWords = std::max((int(langpack_.tags.size()) + 31) / 32, 1);
+	auto tagSets = std::map<std::vector<quint32>, int>();
+	auto tagSetsOrdered = std::vector<std::vector<quint32>>();
+	const auto tagSetIndex = [&](std::vector<quint32> &&bits) {
+		const auto i = tagSets.find(bits);
+		if (i != tagSets.end()) {
+			return i->second;
+		}
+		const auto result = int(tagSetsOrdered.size());
+		tagSets.emplace(bits, result);
+		tagSetsOrdered.push_back(std::move(bits));
+		return result;
+	};
+	tagSetIndex(std::vector<quint32>(tagWords, 0));
+	auto keyTagSets = std::vector<int>(keysCount_, 0);
+	for (auto i = 0, count = int(langpack_.entries.size()); i != count; ++i) {
+		const auto &entry = langpack_.entries[i];
 		if (entry.tags.empty()) {
 			continue;
 		}
-		if (!entry.keyBase.isEmpty()) {
-			if (entry.keyBase == lastWrittenPluralEntry) {
+		auto bits = std::vector<quint32>(tagWords, 0);
+		for (const auto &tag : entry.tags) {
+			const auto index = tagIndices.find(tag.tag);
+			if (index == tagIndices.end()) {
 				continue;
 			}
-			lastWrittenPluralEntry = entry.keyBase;
-			for (auto i = 0; i != kPluralPartCount; ++i) {
-				source_->stream() << "\
-	case " << indexOfKey(ComputePluralKey(entry.keyBase, i)) << ":" << ((i + 1 == kPluralPartCount) ? " {" : "") << "\n";
-			}
+			bits[index->second / 32] |= (quint32(1) << (index->second % 32));
+		}
+		keyTagSets[indices_[i]] = tagSetIndex(std::move(bits));
+	}
+	const auto setType = (tagSetsOrdered.size() <= 0x100) ? "uchar" : "ushort";
+
+	source_->pushNamespace().stream() << "\
+\n\
+constexpr auto kTagWords = " << tagWords << ";\n\
+\n\
+const quint32 TagSets[] = {";
+	auto column = 0;
+	const auto separate = [&](int perLine) {
+		if (column++ % perLine) {
+			source_->stream() << " ";
 		} else {
-			source_->stream() << "\
-	case " << indexOfKey(getFullKey(entry)) << ": {\n";
+			source_->stream() << "\n";
 		}
-		source_->stream() << "\
-		switch (tag) {\n";
-		for (auto &tag : entry.tags) {
-			source_->stream() << "\
-		case lt_" << tag.tag << ":\n";
+	};
+	for (const auto &bits : tagSetsOrdered) {
+		for (const auto word : bits) {
+			separate(8);
+			source_->stream()
+				<< "0x"
+				<< QString::number(word, 16).rightJustified(8, '0').toUpper()
+				<< "U,";
 		}
-		source_->stream() << "\
-			return true;\n\
-		}\n\
-	} break;\n";
 	}
-
-	source_->stream() << "\
-	}\
+	source_->stream() << " };\n\
 \n\
-	return false;\n\
+const " << setType << " KeyTagSets[] = {";
+	column = 0;
+	for (const auto set : keyTagSets) {
+		separate(24);
+		source_->stream() << set << ",";
+	}
+	source_->stream() << " };\n\
+\n";
+	source_->popNamespace().stream() << "\
+\n\
+bool IsTagReplaced(ushort key, ushort tag) {\n\
+	if (key >= kKeysCount || tag >= kTagsCount) {\n\
+		return false;\n\
+	}\n\
+	const auto word = TagSets[KeyTagSets[key] * kTagWords + (tag >> 5)];\n\
+	return (word >> (tag & 31)) & 1;\n\
 }\n\
 \n\
 QString GetOriginalValue(ushort key) {\n\
 	Expects(key < kKeysCount);\n\
 \n\
-	const auto offset = Offsets[key];\n\
 	return QString::fromRawData(\n\
-		reinterpret_cast<const QChar*>(DefaultData + offset),\n\
-		Offsets[key + 1] - offset);\n\
+		reinterpret_cast<const QChar*>(DefaultData + Offsets[key]),\n\
+		Sizes[key]);\n\
 }\n\
 \n";
 
 	return source_->finalize();
 }
 
+void Generator::writeDefaultDataArrays(
+		const std::vector<char16_t> &data,
+		const std::vector<quint32> &offsets,
+		const std::vector<quint32> &sizes) {
+	auto count = 0;
+	const auto separate = [&](bool first) {
+		if (!first) source_->stream() << ",";
+		if (!count++) {
+			source_->stream() << "\n";
+		} else {
+			if (count == 12) {
+				count = 0;
+			}
+			source_->stream() << " ";
+		}
+	};
+	source_->stream() << "\
+const char16_t DefaultData[] = {";
+	for (auto i = 0, size = int(data.size()); i != size; ++i) {
+		separate(!i);
+		source_->stream() << "0x" << QString::number(data[i], 16);
+	}
+	const auto writeList = [&](
+			const QString &name,
+			const std::vector<quint32> &list) {
+		source_->stream() << " };\n\
+\n\
+const " << ChooseOffsetType(list).name << " " << name << "[] = {";
+		count = 0;
+		for (auto i = 0, size = int(list.size()); i != size; ++i) {
+			separate(!i);
+			source_->stream() << list[i];
+		}
+	};
+	writeList("Offsets", offsets);
+	writeList("Sizes", sizes);
+	source_->stream() << " };\n";
+}
+
+bool Generator::writeDefaultDataBlob(
+		const std::vector<char16_t> &data,
+		const std::vector<quint32> &offsets,
+		const std::vector<quint32> &sizes) {
+	auto blob = QByteArray();
+	AppendList(blob, offsets, ChooseOffsetType(offsets));
+	AppendList(blob, sizes, ChooseOffsetType(sizes));
+	AppendData(blob, data);
+
+	const auto path = basePath_ + ".data";
+	if (!WriteIfChanged(path, blob)) {
+		return false;
+	}
+
+	// The hash makes the source change with the data, so that the object
+	// file is rebuilt even if the build system does not track .incbin.
+	const auto symbol = baseName_ + "_data";
+	const auto embed = baseName_.toUpper() + "_DATA_EMBED";
+	const auto dataName = baseName_ + ".data";
+	const auto hash = QCryptographicHash::hash(
+		blob,
+		QCryptographicHash::Md5).toHex();
+	const auto incbin = EscapeString(EscapeString(
+		QFileInfo(path).absoluteFilePath()));
+	const auto byteOrder = (QSysInfo::ByteOrder == QSysInfo::LittleEndian)
+		? "Q_LITTLE_ENDIAN"
+		: "Q_BIG_ENDIAN";
+	source_->newline().stream() << "\
+// Default values data hash: " << hash << "\n\
+// The data is in the byte order of the host that generated it.\n\
+static_assert(Q_BYTE_ORDER == " << byteOrder << ",\n\
+	\"" << dataName << " byte order differs from the target.\");\n\
+\n\
+#if defined __has_embed\n\
+#if __has_embed(\"" << dataName << "\")\n\
+#define " << embed << "\n\
+#endif // __has_embed(\"" << dataName << "\")\n\
+#endif // __has_embed\n\
+\n\
+#ifdef " << embed << "\n\
+\n\
+alignas(4) static const unsigned char " << symbol << "[] = {\n\
+#embed \"" << dataName << "\"\n\
+};\n\
+\n\
+#elif defined __ELF__ // " << embed << "\n\
+\n\
+extern \"C\" const unsigned char " << symbol << "[];\n\
+__asm__(\n\
+	\".pushsection .rodata\\n\"\n\
+	\".balign 4\\n\"\n\
+	\"" << symbol << ":\\n\"\n\
+	\".incbin \\\"" << incbin << "\\\"\\n\"\n\
+	\".popsection\\n\");\n\
+\n\
+#else // " << embed << " || __ELF__\n\
+\n\
+#error \"Binary lang data requires #embed or .incbin support.\"\n\
+\n\
+#endif // " << embed << " || __ELF__\n\
+\n";
+	return true;
+}
+
+std::optional<PackLayout> ReadPackLayout(const QString &destBasePath) {
+	auto result = PackLayout();
+	const auto indicesPath = destBasePath + ".indices";
+	auto indices = QFile(indicesPath);
+	if (!indices.open(QIODevice::ReadOnly)) {
+		common::logError(kErrorBadPackLayout, indicesPath)
+			<< "can not read the key slots, generate the default values first";
+		return std::nullopt;
+	}
+	result.slots = ParseIndices(indices.readAll());
+	for (const auto &[name, slot] : result.slots) {
+		result.keysCount = std::max(result.keysCount, slot.start + slot.size);
+	}
+
+	const auto tagsPath = destBasePath + ".tags";
+	auto tags = QFile(tagsPath);
+	if (!tags.open(QIODevice::ReadOnly)) {
+		common::logError(kErrorBadPackLayout, tagsPath)
+			<< "can not read the tags order, generate the default values first";
+		return std::nullopt;
+	}
+	for (const auto &line : tags.readAll().split('\n')) {
+		const auto tag = QString::fromUtf8(line).trimmed();
+		if (!tag.isEmpty()) {
+			result.tags.push_back({ tag });
+		}
+	}
+	result.hash = LayoutHash(result.slots, result.tags);
+	return result;
+}
+
+bool WritePack(
+		const LangPack &langpack,
+		const PackLayout &layout,
+		const LangPack &translation,
+		const QString &path) {
+	// New tags in the default values would not have the saved order.
+	if (langpack.tags.size() != layout.tags.size()) {
+		common::logError(kErrorBadPackLayout, path)
+			<< "the default values have tags that are not saved yet, "
+			<< "generate the default values first";
+		return false;
+	}
+	auto defaults = std::map<QString, int>();
+	for (auto i = 0, count = int(langpack.entries.size()); i != count; ++i) {
+		defaults.emplace(langpack.entries[i].key, i);
+	}
+
+	// Tags not replaced in the default value can't be in the translation.
+	auto failed = false;
+	const auto keysCount = layout.keysCount;
+	auto byIndex = std::vector<const LangPack::Entry*>(keysCount, nullptr);
+	for (const auto &entry : translation.entries) {
+		const auto i = defaults.find(entry.key);
+		if (i == defaults.end()
+			|| (!entry.keyBase.isEmpty() && entry.value.isEmpty())) {
+			continue; // Removed key or an absent plural part.
+		}
+		const auto &original = langpack.entries[i->second];
+		for (const auto &tag : entry.tags) {
+			const auto j = std::find(
+				original.tags.begin(),
+				original.tags.end(),
+				tag);
+			if (j == original.tags.end()) {
+				common::logError(kErrorBadPackTag, path)
+					<< "tag '" << tag.tag.toStdString()
+					<< "' is not replaced in key '"
+					<< entry.key.toStdString() << "'";
+				failed = true;
+			}
+		}
+
+		const auto isPlural = !original.keyBase.isEmpty();
+		const auto name = isPlural ? original.keyBase : original.key;
+		const auto size = isPlural ? kPluralPartCount : 1;
+		auto shift = 0;
+		while (isPlural
+			&& shift != size
+			&& ComputePluralKey(name, shift) != original.key) {
+			++shift;
+		}
+		const auto slot = layout.slots.find(name);
+		if (slot == layout.slots.end()
+			|| slot->second.size != size
+			|| shift == size) {
+			common::logError(kErrorBadPackLayout, path)
+				<< "key '" << entry.key.toStdString()
+				<< "' has no slot, generate the default values first";
+			failed = true;
+			continue;
+		}
+		byIndex[slot->second.start + shift] = &entry;
+	}
+	if (failed) {
+		return false;
+	}
+
+	const auto values = PackDefaultValues(byIndex);
+	auto present = std::vector<quint32>((keysCount + 31) / 32, 0);
+	for (auto i = 0; i != keysCount; ++i) {
+		if (byIndex[i]) {
+			present[i / 32] |= (quint32(1) << (i % 32));
+		}
+	}
+	const auto offsetType = ChooseOffsetType(values.offsets);
+	const auto sizeType = ChooseOffsetType(values.sizes);
+	const auto offsetsOffset = int(kPackHeaderFields * sizeof(quint32));
+	const auto sizesOffset = offsetsOffset
+		+ AlignedSize(offsetType.size * keysCount);
+	const auto presentOffset = sizesOffset
+		+ AlignedSize(sizeType.size * keysCount);
+	const auto dataOffset = presentOffset
+		+ int(present.size() * sizeof(quint32));
+	const auto header = std::vector<quint32>{
+		kPackMagic,
+		kPackVersion,
+		layout.hash,
+		quint32(keysCount),
+		quint32(offsetType.size),
+		quint32(sizeType.size),
+		quint32(sizesOffset),
+		quint32(presentOffset),
+		quint32(dataOffset),
+	};
+
+	auto blob = QByteArray();
+	AppendList(blob, header, kWordType);
+	AppendList(blob, values.offsets, offsetType);
+	AppendList(blob, values.sizes, sizeType);
+	AppendList(blob, present, kWordType);
+	AppendData(blob, values.data);
+	return WriteIfChanged(path, blob);
+}
+
+bool Generator::writeKeyIndexPerfectHash(
+		const std::vector<std::pair<QString, QString>> &keys) {
+	if (keys.empty()) {
+		// There would be no slots to take the remainder by.
+		source_->stream() << "\
+ushort GetKeyIndex(QLatin1String) {\n\
+	return ushort(kKeysCount);\n\
+}\n\
+\n";
+		return true;
+	}
+	auto names = std::vector<QByteArray>();
+	names.reserve(keys.size());
+	for (const auto &[key, index] : keys) {
+		names.push_back(key.toLatin1());
+	}
+	const auto table = BuildPerfectHash(names);
+	if (!table) {
+		common::logError(kErrorPerfectHashFailed, basePath_)
+			<< "could not build a perfect hash for "
+			<< names.size()
+			<< " keys";
+		return false;
+	}
+	const auto maxSeed = *std::max_element(
+		table->seeds.begin(),
+		table->seeds.end());
+	const auto seedType = (maxSeed <= std::numeric_limits<ushort>::max())
+		? "ushort"
+		: "quint32";
+
+	source_->pushNamespace().stream() << "\
+\n\
+// Must be the same as PerfectHash() in codegen_lang.\n\
+[[nodiscard]] quint32 KeyHash(const char *data, qsizetype size, quint32 seed) {\n\
+	auto result = seed ^ quint32(0x811C9DC5U);\n\
+	for (auto i = qsizetype(0); i != size; ++i) {\n\
+		result ^= uchar(data[i]);\n\
+		result *= quint32(0x01000193U);\n\
+	}\n\
+	result ^= result >> 16;\n\
+	result *= quint32(0x85EBCA6BU);\n\
+	result ^= result >> 13;\n\
+	result *= quint32(0xC2B2AE35U);\n\
+	result ^= result >> 16;\n\
+	return result;\n\
+}\n\
+\n\
+struct KeySlot {\n\
+	quint32 offset = 0;\n\
+	ushort size = 0;\n\
+	ushort index = 0;\n\
+};\n\
+\n\
+constexpr auto kKeySeed = quint32(" << table->seed << ");\n\
+constexpr auto kKeyBuckets = quint32(" << table->seeds.size() << ");\n\
+constexpr auto kKeySlots = quint32(" << table->slots.size() << ");\n\
+\n\
+const " << seedType << " KeySeeds[] = {";
+	auto column = 0;
+	const auto separate = [&](int perLine) {
+		if (column++ % perLine) {
+			source_->stream() << " ";
+		} else {
+			source_->stream() << "\n";
+		}
+	};
+	for (auto i = 0, count = int(table->seeds.size()); i != count; ++i) {
+		separate(12);
+		source_->stream() << table->seeds[i] << ",";
+	}
+	source_->stream() << " };\n\
+\n\
+const char KeyNames[] = {";
+	auto offsets = std::vector<int>(names.size());
+	auto offset = 0;
+	column = 0;
+	for (auto i = 0, count = int(names.size()); i != count; ++i) {
+		offsets[i] = offset;
+		for (const auto ch : names[i]) {
+			separate(16);
+			source_->stream() << "'" << QChar::fromLatin1(ch) << "',";
+		}
+		offset += names[i].size();
+	}
+	source_->stream() << " };\n\
+\n\
+const KeySlot KeySlots[] = {";
+	column = 0;
+	for (const auto key : table->slots) {
+		separate(4);
+		source_->stream()
+			<< "{ "
+			<< offsets[key]
+			<< ", "
+			<< names[key].size()
+			<< ", "
+			<< keys[key].second
+			<< " },";
+	}
+	source_->stream() << " };\n\
+\n";
+	source_->popNamespace().stream() << "\
+\n\
+ushort GetKeyIndex(QLatin1String key) {\n\
+	const auto size = key.size();\n\
+	const auto data = key.data();\n\
+	const auto bucket = KeyHash(data, size, kKeySeed) % kKeyBuckets;\n\
+	const auto &slot = KeySlots[KeyHash(data, size, KeySeeds[bucket]) % kKeySlots];\n\
+	return (slot.size == size && !memcmp(KeyNames + slot.offset, data, size))\n\
+		? slot.index\n\
+		: ushort(kKeysCount);\n\
+}\n\
+\n";
+	return true;
+}
+
 template <typename ComputeResult>
 void Generator::writeSetSearch(const std::set<QString, std::greater<>> &set, ComputeResult computeResult, const QString &invalidResult) {
 	auto tabs = [](int size) {
@@ -8,7 +8,9 @@
 
 #include <memory>
 #include <map>
+#include <optional>
 #include <set>
+#include <vector>
 #include <functional>
 #include <QtCore/QString>
 #include <QtCore/QSet>
@@ -18,9 +20,41 @@
 namespace codegen {
 namespace lang {
 
+// Key slots and the tags order saved by the Generator, the translations
+// are compiled to language packs with them.
+struct PackLayout {
+	struct Slot {
+		int start = 0;
+		int size = 0;
+	};
+	std::map<QString, Slot> slots; // key or plural key base -> slot
+	std::vector<LangPack::Tag> tags;
+	int keysCount = 0;
+	quint32 hash = 0;
+};
+
+// Reads "destBasePath.indices" and "destBasePath.tags" without changes.
+[[nodiscard]] std::optional<PackLayout> ReadPackLayout(
+	const QString &destBasePath);
+
+// Binary translation indexed by the key slots, see writeDefaultDataBlob.
+// Fails if a translated key has no slot in the layout.
+[[nodiscard]] bool WritePack(
+	const LangPack &langpack,
+	const PackLayout &layout,
+	const LangPack &translation,
+	const QString &path);
+
 class Generator {
 public:
-	Generator(const LangPack &langpack, const QString &destBasePath, const common::ProjectInfo &project);
+	// If "perfectHash" is set GetKeyIndex uses a minimal perfect hash.
+	// If "binaryData" is set the default values go to the .data file.
+	Generator(
+		const LangPack &langpack,
+		const QString &destBasePath,
+		const common::ProjectInfo &project,
+		bool perfectHash = false,
+		bool binaryData = false);
 	Generator(const Generator &other) = delete;
 	Generator &operator=(const Generator &other) = delete;
 
@@ -45,6 +79,20 @@ private:
 
 	QString getFullKey(const LangPack::Entry &entry);
 
+	// Pairs of the key name and its index expression.
+	bool writeKeyIndexPerfectHash(
+		const std::vector<std::pair<QString, QString>> &keys);
+
+	// Shared default values data with the offset and size of each key.
+	void writeDefaultDataArrays(
+		const std::vector<char16_t> &data,
+		const std::vector<quint32> &offsets,
+		const std::vector<quint32> &sizes);
+	bool writeDefaultDataBlob(
+		const std::vector<char16_t> &data,
+		const std::vector<quint32> &offsets,
+		const std::vector<quint32> &sizes);
+
 	template <typename ComputeResult>
 	void writeSetSearch(const std::set<QString, std::greater<>> &set, ComputeResult computeResult, const QString &invalidResult);
 
@@ -52,9 +100,12 @@ private:
 	QString basePath_, baseName_;
 	const common::ProjectInfo &project_;
 	std::unique_ptr<common::CppFile> source_, header_;
+	bool perfectHash_ = false;
+	bool binaryData_ = false;
 
 	std::vector<int> indices_;
 	int keysCount_ = 0;
+	quint32 layoutHash_ = 0;
 	bool failed_ = false;
 
 	std::vector<QString> declarations_;
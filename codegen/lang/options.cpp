@@ -64,6 +64,23 @@ Options parseOptions() {
 		} else if (arg.startsWith("-s")) {
 			result.sourcesPath = arg.mid(2);
 
+		// Perfect hash
+		} else if (arg == "--perfect-hash") {
+			result.perfectHash = true;
+
+		// Binary data
+		} else if (arg == "--binary-data") {
+			result.binaryData = true;
+
+		// Compile pack mode
+		} else if (arg == "--compile-pack") {
+			if (i + 2 >= count) {
+				logError(kErrorInputPathExpected, "Command Line") << "expected: --compile-pack input.strings output.pack";
+				return Options();
+			}
+			result.packInputPath = args.at(++i);
+			result.packOutputPath = args.at(++i);
+
 		// Subsets only
 		} else if (arg == "--subsets-only") {
 			result.subsetsOnly = true;
@@ -18,6 +18,16 @@ struct Options {
 
 	QString sourcesPath;
 
+	// Look up the keys by a minimal perfect hash instead of a switch trie.
+	bool perfectHash = false;
+
+	// Write the default values to a binary file linked by #embed or .incbin.
+	bool binaryData = false;
+
+	// --compile-pack mode: compile a translation to a binary language pack.
+	QString packInputPath;
+	QString packOutputPath;
+
 	bool subsetsOnly = false;
 };
 
@@ -46,13 +46,39 @@ int Processor::launch() {
 		return -1;
 	}
 
-	if (!write(parser_->getResult())) {
+	if (!options_.packInputPath.isEmpty()) {
+		return writePack(parser_->getResult()) ? 0 : -1;
+	} else if (!write(parser_->getResult())) {
 		return -1;
 	}
 
 	return 0;
 }
 
+bool Processor::writePack(const LangPack &langpack) const {
+	const auto dstFilePath = QDir(options_.outputPath).absolutePath()
+		+ "/lang_auto";
+
+	// The translation is read with the saved tags order, so the tag
+	// indices in the translated values match the default ones.
+	const auto layout = ReadPackLayout(dstFilePath);
+	if (!layout) {
+		return false;
+	}
+
+	auto options = options_;
+	options.inputPath = options_.packInputPath;
+	auto parser = ParsedFile(options);
+	if (!parser.read()) {
+		return false;
+	}
+	return WritePack(
+		langpack,
+		*layout,
+		parser.getResult(),
+		options_.packOutputPath);
+}
+
 bool Processor::write(const LangPack &langpack) const {
 	QDir dir(options_.outputPath);
 	if (!dir.mkpath(".")) {
@@ -64,7 +90,12 @@ bool Processor::write(const LangPack &langpack) const {
 
 	const auto project = Project(options_.inputPath);
 
-	Generator generator(langpack, dstFilePath, project);
+	Generator generator(
+		langpack,
+		dstFilePath,
+		project,
+		options_.perfectHash,
+		options_.binaryData);
 	if (!generator.writeHeader()
 		|| !generator.writeCounts()
 		|| !generator.writeAllKeys()
@@ -6,7 +6,9 @@
 //
 #include "codegen/lang/subsets.h"
 
+#include "codegen/common/file_hash.h"
 #include "codegen/common/logging.h"
+#include "codegen/common/source_scan.h"
 
 #include <algorithm>
 #include <map>
@@ -15,8 +17,6 @@
 #include <QtCore/QByteArrayList>
 #include <QtCore/QDataStream>
 #include <QtCore/QDateTime>
-#include <QtCore/QDir>
-#include <QtCore/QDirIterator>
 #include <QtCore/QFile>
 #include <QtCore/QFileInfo>
 #include <QtCore/QHash>
@@ -29,21 +29,20 @@ constexpr int kErrorCantReadKeys    = 831;
 constexpr int kErrorCantReadSource  = 832;
 constexpr int kErrorCantWriteSubset = 833;
 
-constexpr auto kCacheVersion = quint32(1);
+constexpr auto kCacheVersion = quint32(5);
 
 const auto kKeysFile = QString("lang_auto_keys.h");
 const auto kSubsetsFolder = QString("lang_subsets");
 const auto kCacheFile = QString("lang_subsets/.cache");
 const auto kDeclarationStart = QByteArray("inline constexpr phrase<");
 const auto kSpecializationStart = QByteArray("struct phrase<");
-const auto kPhraseUsage = QByteArray("phrase<");
 
-[[nodiscard]] bool IsIdentifierChar(char ch) {
-	return (ch >= 'a' && ch <= 'z')
-		|| (ch >= 'A' && ch <= 'Z')
-		|| (ch >= '0' && ch <= '9')
-		|| (ch == '_');
-}
+const auto kScanRules = common::ScanRules{
+	.tokenPrefix = "lng_",
+	.keepPrefix = true,
+	.templateStart = "phrase<",
+	.includes = true,
+};
 
 struct Declarations {
 	std::vector<QByteArray> code;
@@ -52,67 +51,6 @@ struct Declarations {
 	std::vector<QByteArray> combinations;
 };
 
-struct Scanned {
-	qint64 modified = 0;
-	qint64 size = 0;
-	std::vector<QByteArray> tokens;
-	std::vector<QByteArray> combinations;
-	std::vector<QByteArray> includes;
-};
-
-struct SourceFile {
-	QString absolute;
-	QString relative;
-	Scanned scanned;
-	std::vector<int> keys;
-	std::vector<int> included;
-	bool unit = false;
-	bool fresh = false;
-};
-
-struct Cache {
-	QHash<QString, Scanned> scanned;
-	QHash<QString, QByteArray> subsets;
-	qint64 keysModified = 0;
-	qint64 keysSize = 0;
-};
-
-constexpr auto kSaneCount = qint32(1024 * 1024);
-
-QDataStream &operator<<(QDataStream &stream, const Scanned &value) {
-	const auto list = [&](const std::vector<QByteArray> &values) {
-		stream << qint32(values.size());
-		for (const auto &entry : values) {
-			stream << entry;
-		}
-	};
-	stream << value.modified << value.size;
-	list(value.tokens);
-	list(value.combinations);
-	list(value.includes);
-	return stream;
-}
-
-QDataStream &operator>>(QDataStream &stream, Scanned &value) {
-	const auto list = [&](std::vector<QByteArray> &values) {
-		auto count = qint32(0);
-		stream >> count;
-		if (count < 0 || count > kSaneCount) {
-			stream.setStatus(QDataStream::ReadCorruptData);
-			return;
-		}
-		values.resize(count);
-		for (auto &entry : values) {
-			stream >> entry;
-		}
-	};
-	stream >> value.modified >> value.size;
-	list(value.tokens);
-	list(value.combinations);
-	list(value.includes);
-	return stream;
-}
-
 [[nodiscard]] QByteArray NormalizeCombination(const QByteArray &tags) {
 	auto result = QByteArrayList();
 	for (const auto &tag : tags.split(',')) {
@@ -189,106 +127,6 @@ QDataStream &operator>>(QDataStream &stream, Scanned &value) {
 	return true;
 }
 
-void Scan(const QByteArray &content, Scanned &result) {
-	const auto data = content.constData();
-	const auto size = content.size();
-	for (auto i = qsizetype(0); i + 4 < size; ++i) {
-		if (data[i] != 'l'
-			|| data[i + 1] != 'n'
-			|| data[i + 2] != 'g'
-			|| data[i + 3] != '_'
-			|| (i > 0 && IsIdentifierChar(data[i - 1]))) {
-			continue;
-		}
-		auto till = i + 4;
-		while (till != size && IsIdentifierChar(data[till])) {
-			++till;
-		}
-		result.tokens.push_back(content.mid(i, till - i));
-		i = till - 1;
-	}
-	for (auto from = qsizetype(0); from != size;) {
-		const auto found = content.indexOf(kPhraseUsage, from);
-		if (found < 0) {
-			break;
-		}
-		from = found + kPhraseUsage.size();
-		const auto close = content.indexOf('>', from);
-		if (close < 0) {
-			break;
-		}
-		const auto combination = NormalizeCombination(
-			content.mid(from, close - from));
-		if (!combination.isEmpty()) {
-			result.combinations.push_back(combination);
-		}
-		from = close + 1;
-	}
-	const auto directive = QByteArray("#include");
-	for (auto from = qsizetype(0); from != size;) {
-		const auto found = content.indexOf(directive, from);
-		if (found < 0) {
-			break;
-		}
-		from = found + directive.size();
-
-		auto lineStart = found;
-		while (lineStart > 0 && data[lineStart - 1] != '\n') {
-			--lineStart;
-		}
-		auto clean = true;
-		for (auto i = lineStart; i != found; ++i) {
-			if (data[i] != ' ' && data[i] != '\t') {
-				clean = false;
-				break;
-			}
-		}
-		if (!clean) {
-			continue;
-		}
-		auto quote = from;
-		while (quote != size && (data[quote] == ' ' || data[quote] == '\t')) {
-			++quote;
-		}
-		if (quote == size || data[quote] != '"') {
-			continue;
-		}
-		const auto till = content.indexOf('"', quote + 1);
-		if (till < 0) {
-			break;
-		}
-		result.includes.push_back(content.mid(quote + 1, till - quote - 1));
-		from = till + 1;
-	}
-}
-
-[[nodiscard]] Cache ReadCache(const QString &path) {
-	auto result = Cache();
-	auto file = QFile(path);
-	if (!file.open(QIODevice::ReadOnly)) {
-		return result;
-	}
-	auto stream = QDataStream(&file);
-	auto version = quint32(0);
-	stream >> version;
-	if (version != kCacheVersion) {
-		return Cache();
-	}
-	stream >> result.keysModified >> result.keysSize;
-	stream >> result.scanned >> result.subsets;
-	return (stream.status() == QDataStream::Ok) ? result : Cache();
-}
-
-void WriteCache(const QString &path, const Cache &cache) {
-	auto file = QFile(path);
-	if (!file.open(QIODevice::WriteOnly)) {
-		return;
-	}
-	auto stream = QDataStream(&file);
-	stream << kCacheVersion << cache.keysModified << cache.keysSize;
-	stream << cache.scanned << cache.subsets;
-}
-
 [[nodiscard]] QByteArray Signature(
 		const std::vector<int> &keys,
 		const std::set<QByteArray> &combinations) {
@@ -330,6 +168,27 @@ void WriteCache(const QString &path, const Cache &cache) {
 	return true;
 }
 
+// The generated keys header state kept in the common cache.
+struct KeysState {
+	qint64 modified = 0;
+	qint64 size = 0;
+	QByteArray hash;
+};
+
+[[nodiscard]] KeysState ReadKeysState(const QByteArray &state) {
+	auto result = KeysState();
+	auto stream = QDataStream(state);
+	stream >> result.modified >> result.size >> result.hash;
+	return (stream.status() == QDataStream::Ok) ? result : KeysState();
+}
+
+[[nodiscard]] QByteArray SerializeKeysState(const KeysState &state) {
+	auto result = QByteArray();
+	auto stream = QDataStream(&result, QIODevice::WriteOnly);
+	stream << state.modified << state.size << state.hash;
+	return result;
+}
+
 } // namespace
 
 bool WriteSubsets(
@@ -338,67 +197,36 @@ bool WriteSubsets(
 		const common::ProjectInfo &project) {
 	const auto keysPath = genPath + '/' + kKeysFile;
 	const auto keysInfo = QFileInfo(keysPath);
-	auto cache = ReadCache(genPath + '/' + kCacheFile);
-	const auto keysSame = (cache.keysModified
-		== keysInfo.lastModified().toMSecsSinceEpoch())
-		&& (cache.keysSize == keysInfo.size());
-
-	const auto root = QDir(sourcesPath).absolutePath();
-	auto files = std::vector<SourceFile>();
-	auto indices = QHash<QString, int>();
-	auto iterator = QDirIterator(
-		root,
-		QDir::Files,
-		QDirIterator::Subdirectories);
-	while (iterator.hasNext()) {
-		const auto absolute = iterator.next();
-		if (!absolute.endsWith(".cpp")
-			&& !absolute.endsWith(".h")
-			&& !absolute.endsWith(".mm")) {
-			continue;
-		}
-		const auto info = iterator.fileInfo();
-		auto file = SourceFile();
-		file.absolute = absolute;
-		file.relative = absolute.mid(root.size() + 1);
-		file.unit = absolute.endsWith(".cpp") || absolute.endsWith(".mm");
-		file.scanned.modified = info.lastModified().toMSecsSinceEpoch();
-		file.scanned.size = info.size();
-		files.push_back(std::move(file));
-	}
-	std::sort(files.begin(), files.end(), [](const auto &a, const auto &b) {
-		return a.relative < b.relative;
-	});
-	for (auto i = 0, count = int(files.size()); i != count; ++i) {
-		indices.insert(files[i].absolute, i);
+	const auto cachePath = genPath + '/' + kCacheFile;
+	const auto cache = common::ReadSourcesCache(cachePath, kCacheVersion);
+	const auto keysWas = ReadKeysState(cache.state);
+	auto keysNow = KeysState();
+	keysNow.modified = keysInfo.lastModified().toMSecsSinceEpoch();
+	keysNow.size = keysInfo.size();
+	const auto keysTouched = (keysWas.modified != keysNow.modified)
+		|| (keysWas.size != keysNow.size);
+	keysNow.hash = keysTouched
+		? common::HashFileContent(keysPath)
+		: keysWas.hash;
+	const auto keysSame = !keysNow.hash.isEmpty()
+		&& (keysNow.hash == keysWas.hash);
+
+	const auto roots = QStringList{ sourcesPath };
+	auto files = common::CollectSources(roots);
+	auto dirty = !keysSame || (int(cache.scanned.size()) != int(files.size()));
+	if (!common::ScanSources(
+			files,
+			cache,
+			kScanRules,
+			kErrorCantReadSource,
+			&dirty)) {
+		return false;
 	}
 
-	auto dirty = !keysSame || (int(cache.scanned.size()) != int(files.size()));
-	for (auto &file : files) {
-		const auto i = cache.scanned.constFind(file.relative);
-		if (i != cache.scanned.cend()
-			&& i->modified == file.scanned.modified
-			&& i->size == file.scanned.size) {
-			file.scanned = *i;
-			continue;
-		}
-		auto device = QFile(file.absolute);
-		if (!device.open(QIODevice::ReadOnly)) {
-			common::logError(kErrorCantReadSource, file.absolute)
-				<< "can not open the source file for reading";
-			return false;
-		}
-		auto scanned = Scanned();
-		scanned.modified = file.scanned.modified;
-		scanned.size = file.scanned.size;
-		Scan(device.readAll(), scanned);
-		if (i == cache.scanned.cend()
-			|| i->tokens != scanned.tokens
-			|| i->combinations != scanned.combinations
-			|| i->includes != scanned.includes) {
-			dirty = true;
-		}
-		file.scanned = std::move(scanned);
+	auto next = common::SourcesCache();
+	next.state = SerializeKeysState(keysNow);
+	for (const auto &file : files) {
+		next.scanned.insert(file.absolute, file.scanned);
 	}
 
 	const auto subsets = genPath + '/' + kSubsetsFolder;
@@ -412,14 +240,8 @@ bool WriteSubsets(
 			}
 		}
 		if (complete) {
-			auto next = Cache();
-			next.keysModified = keysInfo.lastModified().toMSecsSinceEpoch();
-			next.keysSize = keysInfo.size();
-			next.subsets = cache.subsets;
-			for (const auto &file : files) {
-				next.scanned.insert(file.relative, file.scanned);
-			}
-			WriteCache(genPath + '/' + kCacheFile, next);
+			next.signatures = cache.signatures;
+			common::WriteSourcesCache(cachePath, kCacheVersion, cache, next);
 			return true;
 		}
 	}
@@ -429,92 +251,121 @@ bool WriteSubsets(
 		return false;
 	}
 
-	for (auto &file : files) {
-		for (const auto &token : file.scanned.tokens) {
-			const auto i = declarations.byName.constFind(token);
-			if (i != declarations.byName.cend()) {
-				file.keys.push_back(*i);
+	const auto count = int(files.size());
+	auto keys = std::vector<std::vector<int>>(count);
+	auto used = std::vector<std::vector<QByteArray>>(count);
+	for (auto i = 0; i != count; ++i) {
+		for (const auto &token : files[i].scanned.tokens) {
+			const auto j = declarations.byName.constFind(token);
+			if (j != declarations.byName.cend()) {
+				keys[i].push_back(*j);
 			}
 		}
-		const auto dir = file.absolute.left(file.absolute.lastIndexOf('/'));
-		for (const auto &include : file.scanned.includes) {
-			const auto relative = QString::fromUtf8(include);
-			const auto exact = !relative.contains("..")
-				&& !relative.contains("./");
-			for (const auto &base : { dir, root }) {
-				const auto joined = base + '/' + relative;
-				const auto i = indices.constFind(
-					exact ? joined : QDir::cleanPath(joined));
-				if (i != indices.cend()) {
-					file.included.push_back(*i);
-					break;
-				}
+		for (const auto &tags : files[i].scanned.templates) {
+			auto combination = NormalizeCombination(tags);
+			if (!combination.isEmpty()) {
+				used[i].push_back(std::move(combination));
 			}
 		}
 	}
+	const auto included = common::ResolveIncludes(files, roots);
 
-	auto next = Cache();
-	next.keysModified = keysInfo.lastModified().toMSecsSinceEpoch();
-	next.keysSize = keysInfo.size();
+	// Combinations are numbered in their sorted order, so that the bits
+	// of a closure give them in the same order as the std::set does.
+	auto allCombinations = std::set<QByteArray>();
+	for (const auto &combination : declarations.combinations) {
+		if (!combination.isEmpty()) {
+			allCombinations.emplace(combination);
+		}
+	}
+	for (const auto &list : used) {
+		for (const auto &combination : list) {
+			allCombinations.emplace(combination);
+		}
+	}
+	const auto combinationNames = std::vector<QByteArray>(
+		allCombinations.begin(),
+		allCombinations.end());
+	const auto combinationId = [&](const QByteArray &combination) {
+		return int(std::lower_bound(
+			combinationNames.begin(),
+			combinationNames.end(),
+			combination) - combinationNames.begin());
+	};
+
+	// Files including each other share one closure, every component is
+	// computed once from its own files and the already known successors.
+	struct Closure {
+		common::Bits keys;
+		common::Bits combinations;
+	};
+	const auto components = common::CondenseIncludes(included);
+	auto closures = std::vector<Closure>(components.count, Closure{
+		common::EmptyBits(int(declarations.code.size())),
+		common::EmptyBits(int(combinationNames.size())),
+	});
+	for (auto i = 0; i != count; ++i) {
+		auto &closure = closures[components.index[i]];
+		for (const auto key : keys[i]) {
+			common::SetBit(closure.keys, key);
+			const auto &combination = declarations.combinations[key];
+			if (!combination.isEmpty()) {
+				common::SetBit(
+					closure.combinations,
+					combinationId(combination));
+			}
+		}
+		for (const auto &combination : used[i]) {
+			common::SetBit(closure.combinations, combinationId(combination));
+		}
+	}
+	for (auto component = 0; component != components.count; ++component) {
+		auto &closure = closures[component];
+		for (const auto file : components.files[component]) {
+			for (const auto to : included[file]) {
+				const auto successor = components.index[to];
+				if (successor != component) {
+					common::UniteBits(closure.keys, closures[successor].keys);
+					common::UniteBits(
+						closure.combinations,
+						closures[successor].combinations);
+				}
+			}
+		}
+	}
 
-	auto visited = std::vector<int>(files.size(), -1);
-	auto taken = std::vector<int>(declarations.code.size(), -1);
-	auto queue = std::vector<int>();
-	auto keys = std::vector<int>();
+	auto list = std::vector<int>();
 	auto combinations = std::set<QByteArray>();
-	for (auto i = 0, count = int(files.size()); i != count; ++i) {
-		next.scanned.insert(files[i].relative, files[i].scanned);
+	for (auto i = 0; i != count; ++i) {
 		if (!files[i].unit) {
 			continue;
 		}
-		keys.clear();
+		const auto &closure = closures[components.index[i]];
+		list = common::BitsList(closure.keys);
 		combinations.clear();
-		queue.clear();
-		queue.push_back(i);
-		visited[i] = i;
-		for (auto j = 0; j != int(queue.size()); ++j) {
-			const auto &file = files[queue[j]];
-			for (const auto key : file.keys) {
-				if (taken[key] != i) {
-					taken[key] = i;
-					keys.push_back(key);
-					const auto &combination = declarations.combinations[key];
-					if (!combination.isEmpty()) {
-						combinations.emplace(combination);
-					}
-				}
-			}
-			for (const auto &combination : file.scanned.combinations) {
-				combinations.emplace(combination);
-			}
-			for (const auto included : file.included) {
-				if (visited[included] != i) {
-					visited[included] = i;
-					queue.push_back(included);
-				}
-			}
+		for (const auto id : common::BitsList(closure.combinations)) {
+			combinations.emplace_hint(combinations.end(), combinationNames[id]);
 		}
-		std::sort(keys.begin(), keys.end());
-		const auto signature = Signature(keys, combinations);
-		next.subsets.insert(files[i].relative, signature);
+		const auto signature = Signature(list, combinations);
+		next.signatures.insert(files[i].relative, signature);
 
 		const auto path = subsets + '/' + files[i].relative + ".h";
-		const auto known = cache.subsets.constFind(files[i].relative);
+		const auto known = cache.signatures.constFind(files[i].relative);
 		if (keysSame
-			&& known != cache.subsets.cend()
+			&& known != cache.signatures.cend()
 			&& *known == signature
 			&& QFileInfo::exists(path)) {
 			continue;
 		} else if (!WriteSubset(
 				path,
 				declarations,
-				keys,
+				list,
 				combinations,
 				project)) {
 			return false;
 		}
 	}
-	WriteCache(genPath + '/' + kCacheFile, next);
+	common::WriteSourcesCache(cachePath, kCacheVersion, cache, next);
 	return true;
 }
 
@@ -0,0 +1,140 @@
+// This file is part of Desktop App Toolkit,
+// a set of libraries for developing nice desktop applications.
+//
+// For license and copyright information please follow this link:
+// https://github.com/desktop-app/legal/blob/master/LEGAL
+//
+// Times ModifierChain against the mirrored() / transformed() copy per
+// modifier it replaced, on every png of an icons folder.
+//
+// Usage: codegen_style_benchmark_modifiers <icons folder> [repeats]
+//
+#include "codegen/style/parsed_file.h"
+
+#include <algorithm>
+#include <iostream>
+#include <vector>
+#include <QtCore/QDirIterator>
+#include <QtCore/QElapsedTimer>
+#include <QtCore/QStringList>
+#include <QtGui/QTransform>
+
+namespace {
+
+using codegen::style::ModifierChain;
+
+const auto kChains = std::vector<QStringList>{
+	{ "invert" },
+	{ "flip_horizontal" },
+	{ "flip_vertical" },
+	{ "rotate_cw" },
+	{ "rotate_ccw" },
+	{ "flip_horizontal", "invert" },
+	{ "rotate_cw", "flip_vertical" },
+	{ "rotate_ccw", "invert", "flip_horizontal" },
+};
+
+// The modifiers as they were before ModifierChain.
+void ApplyOld(const QString &name, QImage &image) {
+	if (name == "invert") {
+		image.invertPixels();
+	} else if (name == "flip_horizontal") {
+		image = image.mirrored(true, false);
+	} else if (name == "flip_vertical") {
+		image = image.mirrored(false, true);
+	} else if (name == "rotate_cw") {
+		image = std::move(image).transformed(QTransform().rotate(90));
+	} else if (name == "rotate_ccw") {
+		image = std::move(image).transformed(QTransform().rotate(-90));
+	}
+}
+
+[[nodiscard]] std::vector<QImage> LoadIcons(const QString &folder) {
+	auto result = std::vector<QImage>();
+	auto iterator = QDirIterator(
+		folder,
+		{ "*.png" },
+		QDir::Files,
+		QDirIterator::Subdirectories);
+	while (iterator.hasNext()) {
+		auto image = QImage(iterator.next());
+		if (!image.isNull()) {
+			result.push_back(std::move(image));
+		}
+	}
+	return result;
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+	if (argc != 2 && argc != 3) {
+		std::cerr << "Usage: " << argv[0] << " <icons folder> [repeats]\n";
+		return 1;
+	}
+	const auto icons = LoadIcons(QString::fromLocal8Bit(argv[1]));
+	const auto repeats = (argc == 3) ? QByteArray(argv[2]).toInt() : 20;
+	if (icons.empty() || repeats <= 0) {
+		std::cerr << "No png icons found or bad repeats count.\n";
+		return 1;
+	}
+	auto pixels = qint64();
+	for (const auto &icon : icons) {
+		pixels += qint64(icon.width()) * icon.height();
+	}
+	std::cout
+		<< icons.size() << " icons, "
+		<< pixels << " pixels, "
+		<< repeats << " repeats\n";
+
+	auto timer = QElapsedTimer();
+	auto totalOld = qint64();
+	auto totalChain = qint64();
+	for (const auto &names : kChains) {
+		auto chain = ModifierChain();
+		for (const auto &name : names) {
+			chain.append(name);
+		}
+		auto timeOld = qint64();
+		auto timeChain = qint64();
+		auto mismatches = 0;
+		for (auto repeat = 0; repeat != repeats; ++repeat) {
+			for (const auto &icon : icons) {
+				auto old = icon;
+				timer.start();
+				for (const auto &name : names) {
+					ApplyOld(name, old);
+				}
+				timeOld += timer.nsecsElapsed();
+
+				auto single = icon;
+				timer.start();
+				chain.apply(single);
+				timeChain += timer.nsecsElapsed();
+
+				if (!repeat
+					&& (old.convertToFormat(QImage::Format_ARGB32)
+						!= single.convertToFormat(QImage::Format_ARGB32))) {
+					++mismatches;
+				}
+			}
+		}
+		totalOld += timeOld;
+		totalChain += timeChain;
+		std::cout
+			<< names.join('-').toStdString() << ": "
+			<< (timeOld / repeats / 1000) << " us old, "
+			<< (timeChain / repeats / 1000) << " us single pass, "
+			<< (double(timeOld) / std::max(timeChain, qint64(1))) << "x";
+		if (mismatches) {
+			std::cout << ", " << mismatches << " DIFFERENT";
+		}
+		std::cout << "\n";
+	}
+	std::cout
+		<< "all: "
+		<< (totalOld / repeats / 1000) << " us old, "
+		<< (totalChain / repeats / 1000) << " us single pass, "
+		<< (double(totalOld) / std::max(totalChain, qint64(1))) << "x\n";
+	return 0;
+}
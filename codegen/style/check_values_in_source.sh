@@ -0,0 +1,57 @@
+#!/bin/sh
+# This file is part of Desktop App Toolkit,
+# a set of libraries for developing nice desktop applications.
+#
+# For license and copyright information please follow this link:
+# https://github.com/desktop-app/legal/blob/master/LEGAL
+#
+# Checks that with --values-in-source editing an int or a double value
+# changes only the generated source, not the headers.
+#
+# Usage: check_values_in_source.sh <path to codegen_style>
+
+set -e
+
+if [ "$#" -ne 1 ]; then
+	echo "Usage: $0 <path to codegen_style>" >&2
+	exit 1
+fi
+codegen=$1
+work=$(mktemp -d)
+trap 'rm -rf "$work"' EXIT
+
+generate() {
+	mkdir -p "$work/$1"
+	cat > "$work/$1/check.style" <<EOF
+checkInt: $2;
+checkDouble: $3;
+checkPixels: 4px;
+EOF
+	"$codegen" \
+		-I "$work/$1" \
+		-o "$work/$1/styles" \
+		-t "$work/$1/styles/check.timestamp" \
+		--values-in-source \
+		--refs-headers \
+		"$work/$1/check.style"
+}
+
+generate first 1 0.5
+generate second 2 0.75
+
+status=0
+for file in style_check.h style_check_refs.h; do
+	if ! cmp -s "$work/first/styles/$file" "$work/second/styles/$file"; then
+		echo "FAILED: $file depends on the values" >&2
+		diff "$work/first/styles/$file" "$work/second/styles/$file" >&2 || true
+		status=1
+	fi
+done
+if cmp -s "$work/first/styles/style_check.cpp" "$work/second/styles/style_check.cpp"; then
+	echo "FAILED: style_check.cpp doesn't have the values" >&2
+	status=1
+fi
+if [ "$status" -eq 0 ]; then
+	echo "OK: headers are identical, only the source differs"
+fi
+exit $status
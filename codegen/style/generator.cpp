@@ -9,14 +9,24 @@
 #include "base/crc32hash.h"
 
 #include <set>
+#include <array>
+#include <cmath>
+#include <optional>
+#include <iostream>
 #include <memory>
+#include <algorithm>
 #include <functional>
 #include <QtCore/QDir>
 #include <QtCore/QSet>
 #include <QtCore/QBuffer>
+#include <QtCore/QMargins>
+#include <QtCore/QPoint>
+#include <QtCore/QSize>
+#include <QtGui/QColor>
 #include <QtGui/QImage>
 #include <QtGui/QPainter>
 #include <QtSvg/QSvgRenderer>
+#include "codegen/common/directory_cache.h"
 #include "codegen/style/parsed_file.h"
 
 using Module = codegen::style::structure::Module;
@@ -149,6 +159,60 @@ QString paletteColorValue(const structure::data::color &value) {
 	return result;
 }
 
+// Should match style::internal::EnsureContrast(), the default palette
+// gets the same adjustments at codegen time instead of at startup.
+// Debug builds of the generated palette assert that the results agree.
+constexpr auto kMinContrastAlpha = 64;
+constexpr auto kMinContrastDistance = 64 * 64 * 4;
+constexpr auto kContrastDeltaL = 64;
+
+[[nodiscard]] bool GoodForContrast(const QColor &c1, const QColor &c2) {
+	auto r1 = 0, g1 = 0, b1 = 0;
+	auto r2 = 0, g2 = 0, b2 = 0;
+	c1.getRgb(&r1, &g1, &b1);
+	c2.getRgb(&r2, &g2, &b2);
+	const auto rMean = (r1 + r2) / 2;
+	const auto r = r1 - r2;
+	const auto g = g1 - g2;
+	const auto b = b1 - b2;
+	const auto distance = (((512 + rMean) * r * r) >> 8)
+		+ (4 * g * g)
+		+ (((767 - rMean) * b * b) >> 8);
+	return (distance > kMinContrastDistance);
+}
+
+void EnsureContrast(
+		structure::data::color &over,
+		const structure::data::color &under) {
+	const auto overColor = QColor(over.red, over.green, over.blue, over.alpha);
+	const auto underColor = QColor(
+		under.red,
+		under.green,
+		under.blue,
+		under.alpha);
+	if (overColor.alpha() >= kMinContrastAlpha
+		&& GoodForContrast(overColor, underColor)) {
+		return;
+	}
+	auto overH = 0, overS = 0, overL = 0, overA = 0;
+	auto underH = 0, underS = 0, underL = 0;
+	overColor.getHsl(&overH, &overS, &overL, &overA);
+	underColor.getHsl(&underH, &underS, &underL);
+	const auto newA = std::max(overA, kMinContrastAlpha);
+	const auto newL = (overL > underL && overL + kContrastDeltaL <= 255)
+		? (overL + kContrastDeltaL)
+		: (overL < underL && overL - kContrastDeltaL >= 0)
+		? (overL - kContrastDeltaL)
+		: (underL > 128)
+		? (underL - kContrastDeltaL)
+		: (underL + kContrastDeltaL);
+	const auto result = QColor::fromHsl(overH, overS, newL, newA).toRgb();
+	over.red = uchar(result.red());
+	over.green = uchar(result.green());
+	over.blue = uchar(result.blue());
+	over.alpha = uchar(result.alpha());
+}
+
 [[nodiscard]] bool IsValueInHeader(structure::Type type) {
 	switch (type.tag) {
 	case Tag::Int:
@@ -159,17 +223,49 @@ QString paletteColorValue(const structure::data::color &value) {
 
 } // namespace
 
-Generator::Generator(const structure::Module &module, const QString &destBasePath, const common::ProjectInfo &project, bool isPalette)
+Generator::Generator(
+	const structure::Module &module,
+	const QString &destBasePath,
+	const common::ProjectInfo &project,
+	bool isPalette,
+	bool valuesInSource,
+	bool shareValues,
+	bool packStructs,
+	bool iconAtlas,
+	bool refsHeader,
+	const QSet<QString> *usedNames)
 : module_(module)
 , basePath_(destBasePath)
 , baseName_(QFileInfo(basePath_).baseName())
 , project_(project)
-, isPalette_(isPalette) {
+, isPalette_(isPalette)
+, valuesInSource_(valuesInSource)
+, shareValues_(shareValues)
+, packStructs_(packStructs)
+, iconAtlas_(iconAtlas)
+, refsHeader_(refsHeader)
+, usedNames_(usedNames) {
+}
+
+bool Generator::isValueInHeader(structure::Type type) const {
+	return !valuesInSource_ && IsValueInHeader(type);
+}
+
+bool Generator::isUsed(const Variable &variable) const {
+	return !usedNames_ || usedNames_->contains(variable.name.back());
+}
+
+QString Generator::storageName(const Variable &variable) const {
+	const auto &name = variable.name.back();
+	return '_' + sharedWith_.value(name, name);
 }
 
 bool Generator::writeHeader() {
 	header_ = std::make_unique<common::CppFile>(basePath_ + ".h", project_);
 
+	if (isPalette_) {
+		header_->includeFromLibrary("vector");
+	}
 	header_->include("ui/style/style_core.h").newline();
 
 	if (!writeHeaderRequiredIncludes()) {
@@ -178,11 +274,24 @@ bool Generator::writeHeader() {
 	if (!writeHeaderStyleNamespace()) {
 		return false;
 	}
+	if (refsHeader_) {
+		header_->stream() << "\
+#ifdef STYLE_REFS_SUBSET\n\
+#include STYLE_REFS_SUBSET\n\
+#else // STYLE_REFS_SUBSET\n\
+#include \"styles/" << baseName_ << "_refs.h\"\n\
+#endif // STYLE_REFS_SUBSET\n";
+
+		refs_ = std::make_unique<common::CppFile>(
+			basePath_ + "_refs.h",
+			project_);
+		refs_->include("ui/style/style_core.h").newline();
+	}
 	if (!writeRefsDeclarations()) {
 		return false;
 	}
 
-	return header_->finalize();
+	return header_->finalize() && (!refs_ || refs_->finalize());
 }
 
 bool Generator::writeSource() {
@@ -208,7 +317,9 @@ Module_" << baseName_ << " registrator;\n";
 			source_->newline();
 			source_->stream() << "style::palette _palette;\n";
 		} else {
-			if (!writeVariableDefinitions()) {
+			if (!collectUniqueValues()
+				|| !collectSharedValues()
+				|| !writeVariableDefinitions()) {
 				return false;
 			}
 		}
@@ -228,6 +339,7 @@ Module_" << baseName_ << " registrator;\n";
 			return false;
 		}
 	}
+	collectStats();
 
 	return source_->finalize();
 }
@@ -253,6 +365,72 @@ QString Generator::typeToString(structure::Type type) const {
 	return QString();
 }
 
+// Estimated for a 64 bit build, style::color, style::font
+// and style::icon are wrappers of a single pointer.
+Generator::Layout Generator::typeLayout(structure::Type type) const {
+	const auto layout = [](auto size, auto align) {
+		return Layout{ int(size), int(align) };
+	};
+	const auto pointer = layout(sizeof(void*), alignof(void*));
+	switch (type.tag) {
+	case Tag::Invalid: return Layout();
+	case Tag::Int: return layout(sizeof(int), alignof(int));
+	case Tag::Bool: return layout(sizeof(bool), alignof(bool));
+	case Tag::Double: return layout(sizeof(double), alignof(double));
+	case Tag::Pixels: return layout(sizeof(int), alignof(int));
+	case Tag::String: return layout(sizeof(QString), alignof(QString));
+	case Tag::Color: return pointer;
+	case Tag::Point: return layout(sizeof(QPoint), alignof(QPoint));
+	case Tag::Size: return layout(sizeof(QSize), alignof(QSize));
+	case Tag::Align: return layout(sizeof(Qt::Alignment), alignof(Qt::Alignment));
+	case Tag::Margins: return layout(sizeof(QMargins), alignof(QMargins));
+	case Tag::Font: return pointer;
+	case Tag::Icon: return pointer;
+	case Tag::Struct: {
+		if (const auto realType = module_.findStruct(type.name)) {
+			return structLayout(*realType, fieldsOrder(type.name));
+		}
+		return Layout();
+	} break;
+	}
+	return Layout();
+}
+
+Generator::Layout Generator::structLayout(
+		const structure::Struct &value,
+		const std::vector<int> &order) const {
+	auto result = Layout();
+	for (const auto index : order) {
+		const auto field = typeLayout(value.fields[index].type);
+		result.size = (result.size + field.align - 1) / field.align * field.align;
+		result.size += field.size;
+		result.align = std::max(result.align, field.align);
+	}
+	result.size = (result.size + result.align - 1) / result.align * result.align;
+	return result;
+}
+
+std::vector<int> Generator::fieldsOrder(const structure::FullName &name) const {
+	const auto value = module_.findStruct(name);
+	if (!value) {
+		return {};
+	}
+	auto result = std::vector<int>(value->fields.size());
+	for (auto i = 0, count = int(result.size()); i != count; ++i) {
+		result[i] = i;
+	}
+	if (packStructs_) {
+		auto aligns = std::vector<int>();
+		for (const auto &field : value->fields) {
+			aligns.push_back(typeLayout(field.type).align);
+		}
+		std::stable_sort(result.begin(), result.end(), [&](int a, int b) {
+			return aligns[a] > aligns[b];
+		});
+	}
+	return result;
+}
+
 // Empty result means an error.
 QString Generator::typeToDefaultValue(structure::Type type) const {
 	switch (type.tag) {
@@ -272,8 +450,8 @@ QString Generator::typeToDefaultValue(structure::Type type) const {
 	case Tag::Struct: {
 		if (auto realType = module_.findStruct(type.name)) {
 			QStringList fields;
-			for (const auto &field : realType->fields) {
-				fields.push_back(typeToDefaultValue(field.type));
+			for (const auto index : fieldsOrder(type.name)) {
+				fields.push_back(typeToDefaultValue(realType->fields[index].type));
 			}
 			return "{ " + fields.join(", ") + " }";
 		}
@@ -353,11 +531,15 @@ QString Generator::valueAssignmentCode(
 		return QString("{ %1 }").arg(parts.join(", "));
 	} break;
 	case Tag::Struct: {
-		if (!value.Fields()) return QString();
+		const auto values = value.Fields();
+		if (!values) return QString();
 
 		QStringList fields;
-		for (const auto &field : *value.Fields()) {
-			fields.push_back(valueAssignmentCode(field.variable.value));
+		for (const auto index : fieldsOrder(value.type().name)) {
+			if (index >= values->size()) {
+				return QString();
+			}
+			fields.push_back(valueAssignmentCode(values->at(index).variable.value));
 		}
 		return "{ " + fields.join(", ") + " }";
 	} break;
@@ -515,13 +697,17 @@ namespace internal {\n\
 \n\
 int GetPaletteIndex(QLatin1String name);\n\
 \n\
+// Resolves many names in one merge pass over the sorted names table.\n\
+// Result has -1 for the names that were not found.\n\
+std::vector<int> GetPaletteIndices(const std::vector<QLatin1String> &names);\n\
+\n\
 } // namespace internal\n";
 
 	return true;
 }
 
 bool Generator::writeStructsForwardDeclarations() {
-	bool hasNoExternalStructs = module_.enumVariables([&](const Variable &value) -> bool {
+	bool hasNoExternalStructs = enumVariables([&](const Variable &value) -> bool {
 		if (value.value.type().tag == structure::TypeTag::Struct) {
 			if (!module_.findStructInModule(value.value.type().name, module_)) {
 				return false;
@@ -535,7 +721,7 @@ bool Generator::writeStructsForwardDeclarations() {
 
 	header_->newline();
 	std::set<QString> alreadyDeclaredTypes;
-	bool result = module_.enumVariables([&](const Variable &value) -> bool {
+	bool result = enumVariables([&](const Variable &value) -> bool {
 		if (value.value.type().tag == structure::TypeTag::Struct) {
 			if (!module_.findStructInModule(value.value.type().name, module_)) {
 				if (alreadyDeclaredTypes.find(value.value.type().name.back()) == alreadyDeclaredTypes.end()) {
@@ -556,9 +742,31 @@ bool Generator::writeStructsDefinitions() {
 	}
 
 	bool result = module_.enumStructs([&](const Struct &value) -> bool {
+		const auto order = fieldsOrder(value.name);
+		if (packStructs_) {
+			auto sourceOrder = std::vector<int>(order.size());
+			for (auto i = 0, count = int(order.size()); i != count; ++i) {
+				sourceOrder[i] = i;
+			}
+			const auto was = structLayout(value, sourceOrder).size;
+			const auto now = structLayout(value, order).size;
+			std::cout
+				<< "struct "
+				<< value.name.back().toStdString()
+				<< ": "
+				<< was
+				<< " -> "
+				<< now
+				<< " bytes";
+			if (now < was) {
+				std::cout << ", saved " << (was - now);
+			}
+			std::cout << std::endl;
+		}
 		header_->stream() << "\
 struct " << value.name.back() << " {\n";
-		for (auto &field : value.fields) {
+		for (const auto index : order) {
+			const auto &field = value.fields[index];
 			auto type = typeToString(field.type);
 			if (type.isEmpty()) {
 				return false;
@@ -578,42 +786,61 @@ bool Generator::writeRefsDeclarations() {
 		return true;
 	}
 
-	header_->pushNamespace("st");
+	// Struct types are forward declared in the refs header as well, so
+	// that the subsets can be composed from these files by --subsets-only.
+	auto &refs = refsHeader_ ? *refs_ : *header_;
+	auto structs = std::set<QString>();
+	enumVariables([&](const Variable &value) {
+		if (value.value.type().tag == structure::TypeTag::Struct) {
+			structs.emplace(value.value.type().name.back());
+		}
+		return true;
+	});
+	if (refsHeader_ && !structs.empty()) {
+		refs.pushNamespace("style");
+		for (const auto &name : structs) {
+			refs.stream() << "struct " << name << ";\n";
+		}
+		refs.popNamespace().newline();
+	}
+
+	refs.pushNamespace("st");
 
 	if (isPalette_) {
-		header_->stream() << "extern const style::color &transparent; // special color\n";
-		header_->stream() << "extern const style::color &white; // special color\n";
+		refs.stream() << "extern const style::color &transparent; // special color\n";
+		refs.stream() << "extern const style::color &white; // special color\n";
 	}
-	bool result = module_.enumVariables([&](const Variable &value) -> bool {
+	// With values in source the declarations are sorted by name, so that
+	// the header doesn't depend on the order of variables in the module.
+	auto sorted = std::map<QString, QString>();
+	bool result = enumVariables([&](const Variable &value) -> bool {
 		auto name = value.name.back();
 		auto type = typeToString(value.value.type());
 		if (type.isEmpty()) {
 			return false;
 		}
 
-		if (IsValueInHeader(value.value.type())) {
-			header_->stream()
-				<< "constexpr "
-				<< type
-				<< " "
-				<< name
-				<< " = "
-				<< valueAssignmentCode(
-					value.value,
-					IsValueInHeader(value.value.type()))
-				<< ";\n";
+		const auto declaration = isValueInHeader(value.value.type())
+			? ("constexpr "
+				+ type
+				+ " "
+				+ name
+				+ " = "
+				+ valueAssignmentCode(value.value, true)
+				+ ";\n")
+			: ("extern const " + type + " &" + name + ";\n");
+		if (valuesInSource_) {
+			sorted.emplace(name, declaration);
 		} else {
-			header_->stream()
-				<< "extern const "
-				<< type
-				<< " &"
-				<< name
-				<< ";\n";
+			refs.stream() << declaration;
 		}
 		return true;
 	});
+	for (const auto &[name, declaration] : sorted) {
+		refs.stream() << declaration;
+	}
 
-	header_->popNamespace();
+	refs.popNamespace();
 
 	return result;
 }
@@ -622,6 +849,9 @@ bool Generator::writeIncludesInSource() {
 	if (isPalette_) {
 		source_->include("ui/style/style_core_palette.h");
 		source_->newline();
+		source_->includeFromLibrary("algorithm");
+		source_->includeFromLibrary("string_view");
+		source_->newline();
 	}
 	if (!module_.hasIncludes()) {
 		return true;
@@ -650,13 +880,14 @@ bool Generator::writeVariableDefinitions() {
 	}
 
 	source_->newline();
-	bool result = module_.enumVariables([&](const Variable &variable) -> bool {
+	bool result = enumVariables([&](const Variable &variable) -> bool {
 		auto name = variable.name.back();
 		auto type = typeToString(variable.value.type());
 		if (type.isEmpty()) {
 			return false;
 		}
-		if (!IsValueInHeader(variable.value.type())) {
+		if (!isValueInHeader(variable.value.type())
+			&& !sharedWith_.contains(name)) {
 			source_->stream()
 				<< type
 				<< " _"
@@ -679,20 +910,20 @@ bool Generator::writeRefsDefinition() {
 		source_->stream() << "const style::color &transparent(_palette.transparent()); // special color\n";
 		source_->stream() << "const style::color &white(_palette.white()); // special color\n";
 	}
-	bool result = module_.enumVariables([&](const Variable &variable) -> bool {
+	bool result = enumVariables([&](const Variable &variable) -> bool {
 		auto name = variable.name.back();
 		auto type = typeToString(variable.value.type());
 		if (type.isEmpty()) {
 			return false;
 		}
-		if (IsValueInHeader(variable.value.type())) {
+		if (isValueInHeader(variable.value.type())) {
 			return true;
 		}
 		source_->stream() << "const " << type << " &" << name << "(";
 		if (isPalette_) {
 			source_->stream() << "_palette." << name << "()";
 		} else {
-			source_->stream() << "_" << name;
+			source_->stream() << storageName(variable);
 		}
 		source_->stream() << ");\n";
 		return true;
@@ -701,11 +932,6 @@ bool Generator::writeRefsDefinition() {
 }
 
 bool Generator::writeSetPaletteColor() {
-	source_->stream() << "\n\
-void palette_data::finalize(palette &that) {\n\
-	that.compute(0, -1, { 255, 255, 255, 0}); // special color transparent\n\
-	that.compute(1, -1, { 255, 255, 255, 255}); // special color white\n";
-
 	QList<structure::FullName> names;
 	module_.enumVariables([&](const Variable &variable) -> bool {
 		names.push_back(variable.name);
@@ -713,6 +939,11 @@ void palette_data::finalize(palette &that) {\n\
 	});
 
 	QString dataRows;
+	auto defaults = std::vector<structure::data::color>{
+		{ 255, 255, 255, 0 },
+		{ 255, 255, 255, 255 },
+	};
+	auto fallbacks = std::vector<int>{ -1, -1 };
 	int indexInPalette = 2;
 	QByteArray checksumString;
 	checksumString.append("&transparent:{ 255, 255, 255, 0 }");
@@ -728,7 +959,8 @@ void palette_data::finalize(palette &that) {\n\
 		auto fallbackIterator = paletteIndices_.find(colorFallbackName(variable.value));
 		auto fallbackIndex = (fallbackIterator == paletteIndices_.end()) ? -1 : fallbackIterator->second;
 		auto assignment = QString("{ %1, %2, %3, %4 }").arg(color.red).arg(color.green).arg(color.blue).arg(color.alpha);
-		source_->stream() << "\tthat.compute(" << index << ", " << fallbackIndex << ", " << assignment << ");\n";
+		defaults.push_back(color);
+		fallbacks.push_back(fallbackIndex);
 		checksumString.append(('&' + name + ':' + assignment).toUtf8());
 
 		auto isCopy = !variable.value.copyOf().isEmpty();
@@ -754,15 +986,123 @@ void palette_data::finalize(palette &that) {\n\
 	auto count = indexInPalette;
 	auto checksum = base::crc32(checksumString.constData(), checksumString.size());
 
-	source_->stream() << "\n\n";
+	// The fixups are applied in order, so each pair remembers the values
+	// it expects to see, the precomputed result is valid only for them.
+	struct ContrastPair {
+		int over = 0;
+		int under = 0;
+		structure::data::color overWas;
+		structure::data::color underWas;
+		structure::data::color overNow;
+	};
+	auto contrastPairs = std::vector<ContrastPair>();
+	auto adjusted = defaults;
 	for (const auto &[over, under] : kMustBeContrast) {
 		const auto overIndex = paletteIndices_.find(over);
 		const auto underIndex = paletteIndices_.find(under);
 		if (overIndex == paletteIndices_.end() || underIndex == paletteIndices_.end()) {
 			return false;
 		}
-		source_->stream() << "\tinternal::EnsureContrast(*data(" << overIndex->second << "), *data(" << underIndex->second << "));\n";
+		auto &overColor = adjusted[overIndex->second];
+		const auto &underColor = adjusted[underIndex->second];
+		auto pair = ContrastPair{ overIndex->second, underIndex->second };
+		pair.overWas = overColor;
+		pair.underWas = underColor;
+		EnsureContrast(overColor, underColor);
+		pair.overNow = overColor;
+		contrastPairs.push_back(pair);
 	}
+	const auto colorInitializer = [](const structure::data::color &color) {
+		return QString("{ %1, %2, %3, %4 }"
+		).arg(int(color.red)
+		).arg(int(color.green)
+		).arg(int(color.blue)
+		).arg(int(color.alpha));
+	};
+
+	source_->newline().pushNamespace().newline();
+	source_->stream() << "\
+struct DefaultColor {\n\
+	int fallback = -1;\n\
+	uchar r = 0;\n\
+	uchar g = 0;\n\
+	uchar b = 0;\n\
+	uchar a = 0;\n\
+};\n\
+\n\
+struct Rgba {\n\
+	uchar r = 0;\n\
+	uchar g = 0;\n\
+	uchar b = 0;\n\
+	uchar a = 0;\n\
+\n\
+	[[nodiscard]] QColor color() const {\n\
+		return QColor(r, g, b, a);\n\
+	}\n\
+};\n\
+\n\
+struct ContrastPair {\n\
+	int over = 0;\n\
+	int under = 0;\n\
+	Rgba overWas;\n\
+	Rgba underWas;\n\
+	Rgba overNow;\n\
+};\n\
+\n\
+// Raw default values, the contrast fixups are applied after them.\n\
+constexpr DefaultColor kDefaultColors[] = {\n";
+	for (auto i = 0; i != count; ++i) {
+		const auto &color = defaults[i];
+		source_->stream()
+			<< "\t{ " << fallbacks[i]
+			<< ", " << int(color.red)
+			<< ", " << int(color.green)
+			<< ", " << int(color.blue)
+			<< ", " << int(color.alpha)
+			<< " },\n";
+	}
+	source_->stream() << "\
+};\n\
+\n\
+// If both colors have the values they had at codegen time the result\n\
+// is known, otherwise internal::EnsureContrast() computes it.\n\
+constexpr ContrastPair kContrastPairs[] = {\n";
+	for (const auto &pair : contrastPairs) {
+		source_->stream()
+			<< "\t{ " << pair.over
+			<< ", " << pair.under
+			<< ", " << colorInitializer(pair.overWas)
+			<< ", " << colorInitializer(pair.underWas)
+			<< ", " << colorInitializer(pair.overNow)
+			<< " },\n";
+	}
+	source_->stream() << "\
+};\n\
+\n";
+	source_->popNamespace().newline();
+	source_->stream() << "\
+void palette_data::finalize(palette &that) {\n\
+	for (auto i = 0; i != kCount; ++i) {\n\
+		const auto &color = kDefaultColors[i];\n\
+		that.compute(i, color.fallback, { color.r, color.g, color.b, color.a });\n\
+	}\n\
+	for (const auto &pair : kContrastPairs) {\n\
+		const auto over = data(pair.over);\n\
+		const auto under = data(pair.under);\n\
+		if (over->c != pair.overWas.color()\n\
+			|| under->c != pair.underWas.color()) {\n\
+			internal::EnsureContrast(*over, *under);\n\
+			continue;\n\
+		}\n\
+#ifdef _DEBUG\n\
+		// Checks that the codegen copy matches the runtime one.\n\
+		internal::EnsureContrast(*over, *under);\n\
+		Assert(over->c == pair.overNow.color());\n\
+#else // _DEBUG\n\
+		const auto &now = pair.overNow;\n\
+		over->set(now.r, now.g, now.b, now.a);\n\
+#endif // _DEBUG\n\
+	}\n";
 	source_->stream() << "\
 }\n\
 \n\
@@ -907,6 +1247,10 @@ int GetPaletteIndex(QLatin1String name) {\n\
 	return -1;\n\
 }\n";
 
+	if (!writePaletteIndices()) {
+		return false;
+	}
+
 	source_->newline().popNamespace().newline();
 	source_->stream() << "\
 namespace main_palette {\n\
@@ -929,12 +1273,67 @@ QList<row> data() {\n\
 	return result;
 }
 
+bool Generator::writePaletteIndices() {
+	source_->newline().pushNamespace().newline();
+	source_->stream() << "\
+struct PaletteName {\n\
+	std::string_view name;\n\
+	int index = 0;\n\
+};\n\
+\n\
+constexpr PaletteName kSortedNames[] = {\n";
+
+	// paletteIndices_ is ordered backwards for the GetPaletteIndex() trie.
+	for (auto i = paletteIndices_.rbegin(), e = paletteIndices_.rend(); i != e; ++i) {
+		source_->stream() << "\t{ \"" << i->first << "\", " << i->second << " },\n";
+	}
+	source_->stream() << "\
+};\n\
+\n\
+[[nodiscard]] std::string_view NameView(QLatin1String name) {\n\
+	return std::string_view(name.data(), name.size());\n\
+}\n\
+\n";
+	source_->popNamespace().newline();
+	source_->stream() << "\
+std::vector<int> GetPaletteIndices(const std::vector<QLatin1String> &names) {\n\
+	const auto count = int(names.size());\n\
+	auto result = std::vector<int>(count, -1);\n\
+	auto order = std::vector<int>(count);\n\
+	for (auto i = 0; i != count; ++i) {\n\
+		order[i] = i;\n\
+	}\n\
+	const auto less = [&](int a, int b) {\n\
+		return NameView(names[a]) < NameView(names[b]);\n\
+	};\n\
+	if (!std::is_sorted(order.begin(), order.end(), less)) {\n\
+		std::sort(order.begin(), order.end(), less);\n\
+	}\n\
+\n\
+	auto from = std::begin(kSortedNames);\n\
+	const auto till = std::end(kSortedNames);\n\
+	for (const auto i : order) {\n\
+		const auto name = NameView(names[i]);\n\
+		while (from != till && from->name < name) {\n\
+			++from;\n\
+		}\n\
+		if (from == till) {\n\
+			break;\n\
+		} else if (from->name == name) {\n\
+			result[i] = from->index;\n\
+		}\n\
+	}\n\
+	return result;\n\
+}\n";
+	return true;
+}
+
 bool Generator::writeVariableInit() {
 	if (!module_.hasVariables()) {
 		return true;
 	}
 
-	if (!collectUniqueValues()) {
+	if (isPalette_ && !collectUniqueValues()) {
 		return false;
 	}
 	bool hasUniqueValues = (!pxValues_.isEmpty() || !fontFamilies_.isEmpty() || !iconMasks_.isEmpty());
@@ -986,13 +1385,14 @@ void init_" << baseName_ << "(int scale) {\n\
 
 	if (isPalette_) {
 		source_->stream() << "\t_palette.finalize();\n";
-	} else if (!module_.enumVariables([&](const Variable &variable) -> bool {
+	} else if (!enumVariables([&](const Variable &variable) -> bool {
 		auto name = variable.name.back();
 		auto value = valueAssignmentCode(variable.value);
 		if (value.isEmpty()) {
 			return false;
 		}
-		if (!IsValueInHeader(variable.value.type())) {
+		if (!isValueInHeader(variable.value.type())
+			&& !sharedWith_.contains(name)) {
 			source_->stream() << "\t_" << name << " = " << value << ";\n";
 		}
 		return true;
@@ -1063,7 +1463,22 @@ QByteArray iconMaskValueSize(int width, int height) {
 	const auto fileInfo = QFileInfo(filepath);
 	const auto path = fileInfo.dir().absoluteFilePath(
 		fileInfo.fileName().split('-')[0] + ".svg");
-	return QFileInfo(path).exists() ? path : QString();
+	return common::FileExists(path) ? path : QString();
+}
+
+// Files the mask data depends on, including the missing svg probe.
+[[nodiscard]] QStringList iconMaskDependencies(const QString &filepath) {
+	if (filepath.startsWith("size://")) {
+		return QStringList();
+	}
+	const auto fileInfo = QFileInfo(filepath);
+	const auto base = fileInfo.dir().absoluteFilePath(
+		fileInfo.fileName().split('-')[0]);
+	const auto svg = base + ".svg";
+	if (common::FileExists(svg)) {
+		return { svg };
+	}
+	return { svg, base + ".png", base + "@2x.png", base + "@3x.png" };
 }
 
 [[nodiscard]] QSize iconMaskSizeModifier(const QString &filepath) {
@@ -1114,9 +1529,9 @@ QByteArray iconMaskValueSvg(QString filepath) {
 	return result;
 }
 
-QByteArray iconMaskValuePng(QString filepath) {
-	QByteArray result;
-
+// Reads 1x, 2x and 3x images of the icon with the modifiers applied.
+[[nodiscard]] std::optional<std::array<QImage, 3>> iconMaskImages(
+		QString filepath) {
 	QFileInfo fileInfo(filepath);
 	auto directory = fileInfo.dir();
 	auto nameAndModifiers = fileInfo.fileName().split('-');
@@ -1139,7 +1554,7 @@ QByteArray iconMaskValuePng(QString filepath) {
 	auto png2x = readImage("@2x");
 	auto png3x = readImage("@3x");
 	if (png1x.isNull() || png2x.isNull() || png3x.isNull()) {
-		return result;
+		return std::nullopt;
 	}
 	if (png1x.width() * 2 != png2x.width()
 		|| png1x.height() * 2 != png2x.height()
@@ -1152,14 +1567,21 @@ QByteArray iconMaskValuePng(QString filepath) {
 			<< png2x.width() << "x" << png2x.height()
 			<< ", 3x: "
 			<< png3x.width() << "x" << png3x.height();
-		return result;
+		return std::nullopt;
 	}
+	// Consecutive modifiers are applied together before each resize.
+	auto chain = ModifierChain();
+	const auto applyChain = [&] {
+		chain.apply(png1x);
+		chain.apply(png2x);
+		chain.apply(png3x);
+		chain = ModifierChain();
+	};
 	for (const auto &modifierName : modifiers) {
-		if (const auto modifier = GetModifier(modifierName)) {
-			modifier(png1x);
-			modifier(png2x);
-			modifier(png3x);
+		if (chain.append(modifierName)) {
+			continue;
 		} else if (const auto size = GetSizeModifier(modifierName)) {
+			applyChain();
 			const auto scale = [](QImage &image, QSize size) {
 				image = image.scaled(
 					size,
@@ -1171,9 +1593,57 @@ QByteArray iconMaskValuePng(QString filepath) {
 			scale(png3x, *size * 3);
 		} else {
 			common::logError(common::kErrorInternal, filepath) << "modifier should be valid here, name: " << modifierName.toStdString();
-			return result;
+			return std::nullopt;
+		}
+	}
+	applyChain();
+	return std::array<QImage, 3>{ png1x, png2x, png3x };
+}
+
+// Places the rectangles on shelves, taller first, in a roughly square area.
+[[nodiscard]] std::vector<QRect> packShelves(
+		const std::vector<QSize> &sizes,
+		int gap) {
+	auto area = 0.;
+	auto maxWidth = 0;
+	for (const auto &size : sizes) {
+		area += double(size.width() + gap) * (size.height() + gap);
+		maxWidth = std::max(maxWidth, size.width());
+	}
+	const auto width = std::max(maxWidth, int(std::ceil(std::sqrt(area))));
+
+	auto order = std::vector<int>(sizes.size());
+	for (auto i = 0, count = int(order.size()); i != count; ++i) {
+		order[i] = i;
+	}
+	std::stable_sort(order.begin(), order.end(), [&](int a, int b) {
+		return (sizes[a].height() > sizes[b].height())
+			|| (sizes[a].height() == sizes[b].height()
+				&& sizes[a].width() > sizes[b].width());
+	});
+
+	auto result = std::vector<QRect>(sizes.size());
+	auto x = 0, y = 0, shelfHeight = 0;
+	for (const auto index : order) {
+		const auto &size = sizes[index];
+		if (x > 0 && x + size.width() > width) {
+			y += shelfHeight + gap;
+			x = shelfHeight = 0;
 		}
+		result[index] = QRect(QPoint(x, y), size);
+		x += size.width() + gap;
+		shelfHeight = std::max(shelfHeight, size.height());
+	}
+	return result;
+}
+
+QByteArray iconMaskValuePng(QString filepath) {
+	QByteArray result;
+	const auto images = iconMaskImages(filepath);
+	if (!images) {
+		return result;
 	}
+	const auto &[png1x, png2x, png3x] = *images;
 	QImage composed(png3x.width(), png3x.height() + png2x.height(), QImage::Format_RGB32);
 	composed.fill(Qt::black);
 	{
@@ -1198,8 +1668,14 @@ bool Generator::writeIconValues() {
 
 	// Size variants of one svg share a single embedded copy.
 	auto svgDataOwners = QMap<QString, int>();
+
+	// With iconAtlas_ png masks go to one atlas image per scale.
+	auto atlasImages = std::map<int, std::array<QImage, 3>>();
 	for (auto i = iconMasks_.cbegin(), e = iconMasks_.cend(); i != e; ++i) {
 		const auto filePath = i.key();
+		for (const auto &path : iconMaskDependencies(filePath)) {
+			dependencies_.insert(path);
+		}
 		auto maskData = QByteArray();
 		if (filePath.startsWith("size://")) {
 			const auto dimensions = filePath.mid(7).split(',');
@@ -1214,16 +1690,39 @@ bool Generator::writeIconValues() {
 			}
 			svgDataOwners.insert(svgPath, i.value());
 			maskData = iconMaskValueSvg(filePath);
+		} else if (iconAtlas_) {
+			const auto images = iconMaskImages(filePath);
+			if (!images) {
+				return false;
+			}
+			atlasImages.emplace(i.value(), *images);
+			continue;
 		} else {
 			maskData = iconMaskValuePng(filePath);
 		}
 		if (maskData.isEmpty()) {
 			return false;
 		}
+		const auto svg = maskData.startsWith("SVG:");
+		stats_.icons.push_back({ filePath, maskData.size(), svg });
+		(svg ? stats_.svgBytes : stats_.pngBytes) += maskData.size();
 		source_->stream() << "const uchar iconMask" << i.value() << "Data[] = " << stringToBinaryArray(std::string(maskData.constData(), maskData.size())) << ";\n\n";
 	}
+	const auto atlasRects = writeIconAtlas(atlasImages);
 	for (auto i = iconMasks_.cbegin(), e = iconMasks_.cend(); i != e; ++i) {
 		const auto filePath = i.key();
+		if (const auto j = atlasRects.find(i.value()); j != atlasRects.end()) {
+			const auto &rect = j->second;
+			source_->stream()
+				<< "IconMask iconMask"
+				<< i.value()
+				<< "(iconAtlas, { "
+				<< rect.x() << ", "
+				<< rect.y() << ", "
+				<< rect.width() << ", "
+				<< rect.height() << " });\n";
+			continue;
+		}
 		auto dataIndex = i.value();
 		auto sizeArgument = QString();
 		if (const auto svgPath = iconMaskSvgPath(filePath); !svgPath.isEmpty()) {
@@ -1238,6 +1737,56 @@ bool Generator::writeIconValues() {
 	return true;
 }
 
+std::map<int, QRect> Generator::writeIconAtlas(
+		const std::map<int, std::array<QImage, 3>> &images) {
+	auto result = std::map<int, QRect>();
+	if (images.empty()) {
+		return result;
+	}
+	auto sizes = std::vector<QSize>();
+	for (const auto &[index, scaled] : images) {
+		sizes.push_back(scaled[0].size());
+	}
+
+	// A gap keeps the smooth scaling from bleeding into the neighbours.
+	const auto rects = packShelves(sizes, 1);
+	auto atlasSize = QSize();
+	for (const auto &rect : rects) {
+		atlasSize = atlasSize.expandedTo(QSize(rect.right() + 1, rect.bottom() + 1));
+	}
+	for (auto scale = 1; scale != 4; ++scale) {
+		auto atlas = QImage(atlasSize * scale, QImage::Format_RGB32);
+		atlas.fill(Qt::black);
+		{
+			auto p = QPainter(&atlas);
+			auto rect = rects.begin();
+			for (const auto &[index, scaled] : images) {
+				p.drawImage(rect->topLeft() * scale, scaled[scale - 1]);
+				++rect;
+			}
+		}
+		auto data = QByteArray();
+		{
+			auto buffer = QBuffer(&data);
+			atlas.save(&buffer, "PNG");
+		}
+		stats_.icons.push_back({
+			QString("atlas @%1x").arg(scale),
+			data.size(),
+			false,
+		});
+		stats_.pngBytes += data.size();
+		source_->stream() << "const uchar iconAtlas" << scale << "xData[] = " << stringToBinaryArray(std::string(data.constData(), data.size())) << ";\n\n";
+	}
+	source_->stream() << "IconAtlas iconAtlas(iconAtlas1xData, iconAtlas2xData, iconAtlas3xData);\n\n";
+
+	auto rect = rects.begin();
+	for (const auto &[index, scaled] : images) {
+		result.emplace(index, *rect++);
+	}
+	return result;
+}
+
 bool Generator::collectUniqueValues() {
 	int fontFamilyIndex = 0;
 	int iconMaskIndex = 0;
@@ -1308,7 +1857,68 @@ bool Generator::collectUniqueValues() {
 		}
 		return true;
 	};
-	return module_.enumVariables(collector);
+	return enumVariables(collector);
+}
+
+bool Generator::collectSharedValues() {
+	if (!shareValues_) {
+		return true;
+	}
+	auto owners = QMap<QString, QString>(); // type and value -> variable
+	return enumVariables([&](const Variable &variable) -> bool {
+		const auto type = variable.value.type();
+		if (isValueInHeader(type)) {
+			return true;
+		}
+		const auto value = valueAssignmentCode(variable.value);
+		if (value.isEmpty()) {
+			return false;
+		}
+		const auto key = typeToString(type) + ' ' + value;
+		const auto &name = variable.name.back();
+		const auto i = owners.constFind(key);
+		if (i != owners.cend()) {
+			sharedWith_.insert(name, i.value());
+		} else {
+			owners.insert(key, name);
+		}
+		return true;
+	});
+}
+
+void Generator::collectStats() {
+	stats_.module = QFileInfo(module_.filepath()).fileName();
+	stats_.pxValues = pxValues_.size();
+	stats_.fontFamilies = fontFamilies_.size();
+	stats_.initStatements = pxValues_.size() + fontFamilies_.size();
+
+	auto structVariables = std::map<QString, int>();
+	enumVariables([&](const Variable &variable) {
+		const auto type = variable.value.type();
+		const auto name = (type.tag == Tag::Struct)
+			? type.name.back()
+			: typeToString(type);
+		++stats_.variablesByType[name];
+		if (type.tag == Tag::Struct) {
+			++structVariables[name];
+		}
+		if (!isPalette_
+			&& !isValueInHeader(type)
+			&& !sharedWith_.contains(variable.name.back())) {
+			++stats_.initStatements;
+		}
+		return true;
+	});
+	module_.enumStructs([&](const Struct &value) {
+		const auto name = value.name.back();
+		const auto layout = structLayout(value, fieldsOrder(value.name));
+		stats_.structs.push_back({
+			name,
+			layout.size,
+			structVariables[name],
+		});
+		return true;
+	});
 }
 
 } // namespace style
@@ -6,32 +6,73 @@
 //
 #pragma once
 
+#include <array>
 #include <memory>
 #include <map>
+#include <vector>
 #include <functional>
 #include <QtCore/QString>
 #include <QtCore/QSet>
 #include <QtCore/QMap>
+#include <QtCore/QRect>
+#include <QtGui/QImage>
 #include "codegen/common/cpp_file.h"
+#include "codegen/style/module.h"
+#include "codegen/style/stats.h"
 #include "codegen/style/structure_types.h"
 
 namespace codegen {
 namespace style {
-namespace structure {
-class Module;
-} // namespace structure
 
 class Generator {
 public:
-	Generator(const structure::Module &module, const QString &destBasePath, const common::ProjectInfo &project, bool isPalette);
+	// If "valuesInSource" is set even constexpr values go to the source.
+	// If "shareValues" is set identical values are stored only once.
+	// If "packStructs" is set struct fields are reordered by alignment.
+	// If "iconAtlas" is set png icon masks are packed in atlas images.
+	// If "refsHeader" is set st:: declarations go to a "_refs.h" header.
+	// If "usedNames" is set only those variables are generated.
+	Generator(
+		const structure::Module &module,
+		const QString &destBasePath,
+		const common::ProjectInfo &project,
+		bool isPalette,
+		bool valuesInSource = false,
+		bool shareValues = false,
+		bool packStructs = false,
+		bool iconAtlas = false,
+		bool refsHeader = false,
+		const QSet<QString> *usedNames = nullptr);
 	Generator(const Generator &other) = delete;
 	Generator &operator=(const Generator &other) = delete;
 
 	bool writeHeader();
 	bool writeSource();
 
+	// Icon files read or probed by writeSource().
+	const QSet<QString> &dependencies() const {
+		return dependencies_;
+	}
+
+	// Filled by writeSource().
+	const ModuleStats &stats() const {
+		return stats_;
+	}
+
 private:
+	struct Layout {
+		int size = 0;
+		int align = 1;
+	};
+
 	QString typeToString(structure::Type type) const;
+	Layout typeLayout(structure::Type type) const;
+	Layout structLayout(
+		const structure::Struct &value,
+		const std::vector<int> &order) const;
+
+	// Indices of the struct fields in the order they are declared.
+	std::vector<int> fieldsOrder(const structure::FullName &name) const;
 	QString typeToDefaultValue(structure::Type type) const;
 	QString valueAssignmentCode(
 		structure::Value value,
@@ -48,23 +89,53 @@ private:
 	bool writeVariableDefinitions();
 	bool writeRefsDefinition();
 	bool writeSetPaletteColor();
+	bool writePaletteIndices();
 	bool writeVariableInit();
 	bool writePxValuesInit();
 	bool writeFontFamiliesInit();
 	bool writeIconValues();
+
+	// Returns 1x rects of the masks in the atlas by mask index.
+	std::map<int, QRect> writeIconAtlas(
+		const std::map<int, std::array<QImage, 3>> &images);
 	bool writeIconsInit();
 
 	bool collectUniqueValues();
+	bool collectSharedValues();
+	void collectStats();
+
+	// Name of the variable holding the value, it may be shared.
+	QString storageName(const structure::Variable &variable) const;
+
+	bool isValueInHeader(structure::Type type) const;
+	bool isUsed(const structure::Variable &variable) const;
+
+	// Enumerates only the variables that should be generated.
+	template <typename F>
+	bool enumVariables(F functor) const {
+		return module_.enumVariables([&](const structure::Variable &value) {
+			return !isUsed(value) || functor(value);
+		});
+	}
 
 	const structure::Module &module_;
 	QString basePath_, baseName_;
 	const common::ProjectInfo &project_;
-	std::unique_ptr<common::CppFile> source_, header_;
+	std::unique_ptr<common::CppFile> source_, header_, refs_;
 	bool isPalette_ = false;
+	bool valuesInSource_ = false;
+	bool shareValues_ = false;
+	bool packStructs_ = false;
+	bool iconAtlas_ = false;
+	bool refsHeader_ = false;
+	const QSet<QString> *usedNames_ = nullptr;
 
 	QMap<int, bool> pxValues_;
 	QMap<std::string, int> fontFamilies_;
 	QMap<QString, int> iconMasks_; // icon file -> index
+	QMap<QString, QString> sharedWith_; // variable -> value owner
+	QSet<QString> dependencies_;
+	ModuleStats stats_;
 	std::map<QString, int, std::greater<QString>> paletteIndices_;
 
 };
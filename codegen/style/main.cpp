@@ -17,9 +17,11 @@ int main(int argc, char *argv[]) {
 
 	if (!options.renderSvgInput.isEmpty()) {
 		return codegen::style::RenderSvg(options);
+	} else if (!options.renderSvgManifest.isEmpty()) {
+		return codegen::style::RenderSvgBatch(options);
 	}
 
-	if (options.inputPaths.isEmpty()) {
+	if (options.inputPaths.isEmpty() && !options.subsetsOnly) {
 		return -1;
 	}
 
@@ -7,6 +7,7 @@
 #pragma once
 
 #include <QtCore/QString>
+#include <QtCore/QStringList>
 #include <QtCore/QList>
 #include <QtCore/QMap>
 #include <vector>
@@ -27,6 +28,15 @@ public:
 
 	void addIncluded(std::shared_ptr<const Module> value);
 
+	// Paths looked up before the used files were found, a file
+	// appearing at one of them would be used instead.
+	void addProbed(const QString &path) {
+		probed_.push_back(path);
+	}
+	const QStringList &probed() const {
+		return probed_;
+	}
+
 	bool hasIncludes() const {
 		return !included_.empty();
 	}
@@ -89,6 +99,7 @@ public:
 private:
 	QString fullpath_;
 	std::vector<std::shared_ptr<const Module>> included_;
+	QStringList probed_;
 	QList<Struct> structs_;
 	QList<Variable> variables_;
 	QMap<QString, int> structsByName_;
@@ -19,6 +19,7 @@ constexpr int kErrorIncludePathExpected     = 901;
 constexpr int kErrorOutputPathExpected      = 902;
 constexpr int kErrorInputPathExpected       = 903;
 constexpr int kErrorWorkingPathExpected     = 905;
+constexpr int kErrorSourcesPathExpected     = 906;
 
 } // namespace
 
@@ -26,6 +27,7 @@ using common::logError;
 
 Options parseOptions() {
 	Options result;
+	auto outputPathSet = false;
 	auto args = QCoreApplication::instance()->arguments();
 	for (int i = 1, count = args.size(); i < count; ++i) { // skip first
 		auto &arg = args.at(i);
@@ -48,9 +50,11 @@ Options parseOptions() {
 				return Options();
 			} else {
 				result.outputPath = args.at(i);
+				outputPathSet = true;
 			}
 		} else if (arg.startsWith("-o")) {
 			result.outputPath = arg.mid(2);
+			outputPathSet = true;
 
 		// Timestamp path
 		} else if (arg == "-t") {
@@ -74,6 +78,56 @@ Options parseOptions() {
 		} else if (arg.startsWith("-w")) {
 			common::logSetWorkingPath(arg.mid(2));
 
+		// Sources path
+		} else if (arg == "-s") {
+			if (++i == count) {
+				logError(kErrorSourcesPathExpected, "Command Line") << "sources path expected after -s";
+				return Options();
+			} else {
+				result.sourcesPaths.push_back(args.at(i));
+			}
+		} else if (arg.startsWith("-s")) {
+			result.sourcesPaths.push_back(arg.mid(2));
+
+		// Values in source
+		} else if (arg == "--values-in-source") {
+			result.valuesInSource = true;
+
+		// Share values
+		} else if (arg == "--share-values") {
+			result.shareValues = true;
+
+		// Pack structs
+		} else if (arg == "--pack-structs") {
+			result.packStructs = true;
+
+		// Icon atlas
+		} else if (arg == "--icon-atlas") {
+			result.iconAtlas = true;
+
+		// Snapshot
+		} else if (arg == "--snapshot") {
+			result.snapshot = true;
+
+		// Stats
+		} else if (arg == "--stats") {
+			result.stats = true;
+		} else if (arg == "--stats-json") {
+			if (++i == count) {
+				logError(kErrorOutputPathExpected, "Command Line") << "stats path expected after --stats-json";
+				return Options();
+			} else {
+				result.statsJsonPath = args.at(i);
+			}
+
+		// Refs headers
+		} else if (arg == "--refs-headers") {
+			result.refsHeaders = true;
+
+		// Subsets only
+		} else if (arg == "--subsets-only") {
+			result.subsetsOnly = true;
+
 		// Render SVG mode
 		} else if (arg == "--render-svg") {
 			if (i + 2 >= count) {
@@ -91,12 +145,39 @@ Options parseOptions() {
 				}
 			}
 
+		// Render SVG batch mode
+		} else if (arg == "--render-svg-batch") {
+			if (i + 1 >= count) {
+				logError(kErrorInputPathExpected, "Command Line") << "expected: --render-svg-batch manifest [size]";
+				return Options();
+			}
+			result.renderSvgManifest = args.at(++i);
+			if (i + 1 < count) {
+				auto ok = false;
+				auto size = args.at(i + 1).toInt(&ok);
+				if (ok && size > 0) {
+					result.renderSvgSize = size;
+					++i;
+				}
+			}
+
 		// Input path
 		} else {
 			result.inputPaths.push_back(arg);
 		}
 	}
-	if (!result.renderSvgInput.isEmpty()) {
+	if (!result.renderSvgInput.isEmpty()
+		|| !result.renderSvgManifest.isEmpty()) {
+		return result;
+	}
+	if (result.subsetsOnly) {
+		if (result.sourcesPaths.isEmpty()) {
+			logError(kErrorSourcesPathExpected, "Command Line") << "sources path expected for --subsets-only";
+			return Options();
+		} else if (!outputPathSet || result.outputPath.isEmpty()) {
+			logError(kErrorOutputPathExpected, "Command Line") << "output path expected for --subsets-only";
+			return Options();
+		}
 		return result;
 	}
 	if (result.timestampPath.isEmpty()) {
@@ -19,10 +19,42 @@ struct Options {
 	QStringList inputPaths;
 	bool isPalette = false;
 
+	// Keep all values in the generated source, so that editing a value
+	// doesn't change the generated headers.
+	bool valuesInSource = false;
+
+	// Variables with identical values share a single storage object.
+	bool shareValues = false;
+
+	// Reorder struct fields by alignment to minimize the padding.
+	bool packStructs = false;
+
+	// Pack png icon masks of a module in one atlas image per scale.
+	bool iconAtlas = false;
+
+	// Drop variables not used as "st::name" in any of these sources.
+	QStringList sourcesPaths;
+
+	// Also write a binary snapshot of the values with an offsets header.
+	bool snapshot = false;
+
+	// --stats prints and --stats-json writes what the modules consist of.
+	bool stats = false;
+	QString statsJsonPath;
+
+	// Put st:: declarations in "_refs.h" headers for the subsets.
+	bool refsHeaders = false;
+
+	// --subsets-only mode: write per translation unit refs subsets.
+	bool subsetsOnly = false;
+
 	// --render-svg mode: render SVG to PNG preview.
 	QString renderSvgInput;
 	QString renderSvgOutput;
 	int renderSvgSize = 512;
+
+	// --render-svg-batch mode: render all SVGs listed in the manifest.
+	QString renderSvgManifest;
 };
 
 // Parsing failed if inputPath is empty in the result.
@@ -6,11 +6,13 @@
 //
 #include "codegen/style/parsed_file.h"
 
+#include <cstring>
 #include <iostream>
 #include <QtCore/QMap>
 #include <QtCore/QDir>
 #include <QtCore/QRegularExpression>
 #include "codegen/common/basic_tokenized_file.h"
+#include "codegen/common/directory_cache.h"
 #include "codegen/common/logging.h"
 #include "base/qt/qt_string_view.h"
 
@@ -34,12 +36,16 @@ constexpr int kErrorIconDuplicate      = 807;
 constexpr int kErrorBadIconModifier    = 808;
 constexpr int kErrorCyclicDependency   = 809;
 
-QString findInputFile(const Options &options, int index) {
+QString findInputFile(
+		const Options &options,
+		int index,
+		QStringList &probed) {
 	for (const auto &dir : options.includePaths) {
 		QString tryPath = QDir(dir).absolutePath() + '/' + options.inputPaths[index];
-		if (QFileInfo::exists(tryPath)) {
+		if (common::FileExists(tryPath)) {
 			return tryPath;
 		}
+		probed.push_back(tryPath);
 	}
 	return options.inputPaths[index];
 }
@@ -125,25 +131,100 @@ bool validateAlignString(const QString &value) {
 } // namespace
 
 Modifier GetModifier(const QString &name) {
-	static QMap<QString, Modifier> modifiers;
-	if (modifiers.empty()) {
-		modifiers.insert("invert", [](QImage &image) {
-			image.invertPixels();
-		});
-		modifiers.insert("flip_horizontal", [](QImage &image) {
-			image = image.mirrored(true, false);
-		});
-		modifiers.insert("flip_vertical", [](QImage &image) {
-			image = image.mirrored(false, true);
-		});
-		modifiers.insert("rotate_cw", [](QImage &image) {
-			image = std::move(image).transformed(QTransform().rotate(90));
-		});
-		modifiers.insert("rotate_ccw", [](QImage &image) {
-			image = std::move(image).transformed(QTransform().rotate(-90));
-		});
+	auto chain = ModifierChain();
+	if (!chain.append(name)) {
+		return Modifier();
 	}
-	return modifiers.value(name);
+	return [=](QImage &image) {
+		chain.apply(image);
+	};
+}
+
+bool ModifierChain::append(const QString &name) {
+	// Flip goes first, so F * R^k = R^-k * F is used for the flips.
+	if (name == "invert") {
+		invert_ = !invert_;
+	} else if (name == "flip_horizontal") {
+		rotation_ = (4 - rotation_) % 4;
+		flip_ = !flip_;
+	} else if (name == "flip_vertical") {
+		rotation_ = (6 - rotation_) % 4;
+		flip_ = !flip_;
+	} else if (name == "rotate_cw") {
+		rotation_ = (rotation_ + 1) % 4;
+	} else if (name == "rotate_ccw") {
+		rotation_ = (rotation_ + 3) % 4;
+	} else {
+		return false;
+	}
+	return true;
+}
+
+bool ModifierChain::empty() const {
+	return !rotation_ && !flip_ && !invert_;
+}
+
+void ModifierChain::apply(QImage &image) const {
+	if (empty() || image.isNull()) {
+		return;
+	}
+	if (image.format() != QImage::Format_RGB32
+		&& image.format() != QImage::Format_ARGB32) {
+		image = std::move(image).convertToFormat(QImage::Format_RGB32);
+	}
+	const auto mask = invert_ ? quint32(0x00FFFFFFU) : quint32(0);
+	const auto width = image.width();
+	const auto height = image.height();
+	if (!rotation_ && !flip_) {
+		for (auto y = 0; y != height; ++y) {
+			const auto line = reinterpret_cast<quint32*>(image.scanLine(y));
+			for (auto x = 0; x != width; ++x) {
+				line[x] ^= mask;
+			}
+		}
+		return;
+	}
+	const auto turned = (rotation_ % 2) != 0;
+	auto result = QImage(
+		turned ? height : width,
+		turned ? width : height,
+		image.format());
+	const auto stride = result.bytesPerLine() / int(sizeof(quint32));
+	const auto to = reinterpret_cast<quint32*>(result.bits());
+
+	// Destination index of the source pixel (x, y), linear in x.
+	const auto index = [&](int x, int y) {
+		if (flip_) {
+			x = width - 1 - x;
+		}
+		switch (rotation_) {
+		case 1: return x * stride + (height - 1 - y);
+		case 2: return (height - 1 - y) * stride + (width - 1 - x);
+		case 3: return (width - 1 - x) * stride + y;
+		}
+		return y * stride + x;
+	};
+	const auto step = (width > 1) ? (index(1, 0) - index(0, 0)) : 0;
+	for (auto y = 0; y != height; ++y) {
+		const auto from = reinterpret_cast<const quint32*>(
+			std::as_const(image).scanLine(y));
+		auto destination = to + index(0, y);
+		if (step == 1) {
+			// Whole rows land contiguously (flip_vertical), copy them.
+			std::memcpy(destination, from, width * sizeof(quint32));
+			if (mask) {
+				for (auto x = 0; x != width; ++x) {
+					destination[x] ^= mask;
+				}
+			}
+			continue;
+		}
+		for (auto x = 0; x != width; ++x, destination += step) {
+			*destination = from[x] ^ mask;
+		}
+	}
+	result.setDevicePixelRatio(image.devicePixelRatio());
+	image = std::move(result);
 }
 
 std::optional<QSize> GetSizeModifier(const QString &value) {
@@ -166,7 +247,7 @@ ParsedFile::ParsedFile(
 	int index,
 	std::vector<QString> includeStack)
 : includeCache_(includeCache)
-, filePath_(findInputFile(options, index))
+, filePath_(findInputFile(options, index, probed_))
 , file_(filePath_)
 , options_(options)
 , includeStack_(includeStack) {
@@ -183,6 +264,9 @@ bool ParsedFile::read() {
 
 	auto absolutePath = QFileInfo(filePath_).absoluteFilePath();
 	module_ = std::make_unique<structure::Module>(absolutePath);
+	for (const auto &path : std::as_const(probed_)) {
+		module_->addProbed(path);
+	}
 	do {
 		if (auto startToken = file_.getToken(BasicType::Name)) {
 			if (tokenValue(startToken) == "using") {
@@ -1001,18 +1085,22 @@ QString ParsedFile::readMonoIconFilename() {
 				}
 			}
 			for (auto &path : options_.includePaths) {
-				QFileInfo png(path + '/' + filepath + ".png");
-				QFileInfo svg(path + '/' + filepath + ".svg");
-				if (png.exists() || svg.exists()) {
+				const auto base = path + '/' + filepath;
+				if (common::FileExists(base + ".png")
+					|| common::FileExists(base + ".svg")) {
 					return path + '/' + fullpath;
 				}
+				module_->addProbed(base + ".png");
+				module_->addProbed(base + ".svg");
 			}
 			for (auto &path : options_.includePaths) {
-				QFileInfo png(path + "/icons/" + filepath + ".png");
-				QFileInfo svg(path + "/icons/" + filepath + ".svg");
-				if (png.exists() || svg.exists()) {
+				const auto base = path + "/icons/" + filepath;
+				if (common::FileExists(base + ".png")
+					|| common::FileExists(base + ".svg")) {
 					return path + "/icons/" + fullpath;
 				}
+				module_->addProbed(base + ".png");
+				module_->addProbed(base + ".svg");
 			}
 			logError(common::kErrorFileNotFound) << "could not open icon file '" << filename.String() << "'";
 		} else if (filename.type().tag == structure::TypeTag::Size) {
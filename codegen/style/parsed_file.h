@@ -20,6 +20,23 @@ namespace style {
 using Modifier = std::function<void(QImage &image)>;
 Modifier GetModifier(const QString &name);
 
+// Composes a sequence of modifiers into one flip, rotation and inversion,
+// applied to the image in a single pass over its pixels.
+class ModifierChain {
+public:
+	// Returns false if the name is not a modifier.
+	bool append(const QString &name);
+
+	[[nodiscard]] bool empty() const;
+	void apply(QImage &image) const;
+
+private:
+	int rotation_ = 0; // clockwise quarter turns after the flip
+	bool flip_ = false; // horizontal flip
+	bool invert_ = false;
+
+};
+
 [[nodiscard]] std::optional<QSize> GetSizeModifier(const QString &value);
 
 // Parses an input file to the internal struct.
@@ -110,6 +127,7 @@ private:
 
 	std::map<QString, std::shared_ptr<const structure::Module>> includeCache_;
 
+	QStringList probed_;
 	QString filePath_;
 	common::BasicTokenizedFile file_;
 	Options options_;
@@ -6,48 +6,307 @@
 //
 #include "codegen/style/processor.h"
 
+#include <functional>
+#include <QtCore/QCoreApplication>
+#include <QtCore/QDataStream>
 #include <QtCore/QDir>
+#include <QtCore/QFile>
 #include <QtCore/QFileInfo>
+#include <QtCore/QMap>
 #include "codegen/common/cpp_file.h"
+#include "codegen/common/directory_cache.h"
+#include "codegen/common/file_hash.h"
 #include "codegen/style/parsed_file.h"
 #include "codegen/style/generator.h"
+#include "codegen/style/snapshot.h"
+#include "codegen/style/subsets.h"
+#include "codegen/style/usages.h"
 
 namespace codegen {
 namespace style {
+
+QDataStream &operator<<(QDataStream &stream, const Fingerprint &value) {
+	return stream
+		<< value.config
+		<< value.outputs
+		<< value.inputs
+		<< value.tool;
+}
+
+QDataStream &operator>>(QDataStream &stream, Fingerprint &value) {
+	return stream
+		>> value.config
+		>> value.outputs
+		>> value.inputs
+		>> value.tool;
+}
+
 namespace {
 
 constexpr int kErrorCantWritePath = 821;
 
+const auto kUsagesCacheFile = QString(".usages");
+const auto kManifestSuffix = QString(".manifest");
+
+constexpr auto kManifestVersion = quint32(2);
+
 QString destFileBaseName(const structure::Module &module) {
 	return "style_" + QFileInfo(module.filepath()).baseName();
 }
 
+[[nodiscard]] Manifest ReadManifest(const QString &path) {
+	auto result = Manifest();
+	auto file = QFile(path);
+	if (!file.open(QIODevice::ReadOnly)) {
+		return result;
+	}
+	auto stream = QDataStream(&file);
+	auto version = quint32(0);
+	stream >> version;
+	if (version != kManifestVersion) {
+		return result;
+	}
+	stream >> result;
+	return (stream.status() == QDataStream::Ok) ? result : Manifest();
+}
+
+void WriteManifest(const QString &path, const Manifest &manifest) {
+	auto file = QFile(path);
+	if (!file.open(QIODevice::WriteOnly)) {
+		return;
+	}
+	auto stream = QDataStream(&file);
+	stream << kManifestVersion << manifest;
+}
+
+// Only the inputs with a changed modification time or size are hashed,
+// their new stamps are stored in the fingerprint if the content is same.
+[[nodiscard]] bool UpToDate(
+		Fingerprint &fingerprint,
+		const QByteArray &config) {
+	if (fingerprint.config != config || fingerprint.inputs.isEmpty()) {
+		return false;
+	}
+	for (const auto &output : fingerprint.outputs) {
+		if (!common::FileExists(output)) {
+			return false;
+		}
+	}
+	for (auto i = fingerprint.inputs.begin(); i != fingerprint.inputs.end(); ++i) {
+		auto now = common::StampFile(i.key(), i.value());
+		if (now.hash != i.value().hash) {
+			return false;
+		}
+		i.value() = std::move(now);
+	}
+	return true;
+}
+
+[[nodiscard]] common::FileStamp ToolStamp(const Manifest &manifest) {
+	return common::StampFile(
+		QCoreApplication::applicationFilePath(),
+		manifest.isEmpty() ? common::FileStamp() : manifest.first().tool);
+}
+
+void AddModuleInputs(
+		const structure::Module &module,
+		QMap<QString, common::FileStamp> &inputs) {
+	std::function<bool(const structure::Module&)> add = [&](
+			const structure::Module &module) {
+		if (!inputs.contains(module.filepath())) {
+			inputs.insert(
+				module.filepath(),
+				common::StampFile(module.filepath()));
+			for (const auto &path : module.probed()) {
+				if (!inputs.contains(path)) {
+					inputs.insert(path, common::StampFile(path));
+				}
+			}
+			module.enumIncludes(add);
+		}
+		return true;
+	};
+	add(module);
+}
+
+// A missing file can't be a dependency, the nearest existing directory
+// is used instead, adding the file changes its modification time.
+[[nodiscard]] QString ExistingDirectory(const QString &path) {
+	auto result = QFileInfo(path).absolutePath();
+	while (!QFileInfo::exists(result)) {
+		const auto parent = QFileInfo(result).absolutePath();
+		if (parent == result) {
+			break;
+		}
+		result = parent;
+	}
+	return result;
+}
+
 } // namespace
 
 Processor::Processor(const Options &options)
 : options_(options) {
 }
 
+QByteArray Processor::config() const {
+	auto result = QByteArray();
+	auto stream = QDataStream(&result, QIODevice::WriteOnly);
+	stream
+		<< tool_.hash
+		<< options_.includePaths
+		<< options_.isPalette
+		<< options_.valuesInSource
+		<< options_.shareValues
+		<< options_.packStructs
+		<< options_.iconAtlas
+		<< options_.snapshot
+		<< options_.refsHeaders;
+	return result;
+}
+
+// With used names filtering a module output depends only on which of
+// its own variables are used, not on all the names used in the sources.
+QByteArray Processor::moduleConfig(
+		const structure::Module &module,
+		const QByteArray &config) const {
+	if (!usedNames_) {
+		return config;
+	}
+	auto names = QStringList();
+	module.enumVariables([&](const structure::Variable &variable) {
+		const auto &name = variable.name.back();
+		if (usedNames_->contains(name)) {
+			names.push_back(name);
+		}
+		return true;
+	});
+	names.sort();
+	auto result = config;
+	auto stream = QDataStream(&result, QIODevice::Append);
+	stream << names;
+	return result;
+}
+
 int Processor::launch() {
+	if (options_.subsetsOnly) {
+		const auto project = common::ProjectInfo{
+			"codegen_style",
+			"*_refs.h",
+			false,
+		};
+		return WriteSubsets(
+			options_.outputPath,
+			options_.sourcesPaths,
+			project) ? 0 : -1;
+	}
+
+	const auto manifestPath = options_.timestampPath + kManifestSuffix;
+	const auto manifest = ReadManifest(manifestPath);
+	auto updated = Manifest();
+
+	// Without used names filtering each module output depends only on its
+	// own files, so the unchanged ones are not even parsed.
+	const auto filterUsed = !options_.sourcesPaths.isEmpty()
+		&& !options_.isPalette;
+
+	// Stats are gathered while generating, so nothing is skipped for them.
+	const auto collectStats = options_.stats
+		|| !options_.statsJsonPath.isEmpty();
+	tool_ = ToolStamp(manifest);
+	const auto config = this->config();
+
+	auto sources = QStringList();
 	auto cache = std::map<QString, std::shared_ptr<const structure::Module>>();
+	auto modules = std::vector<std::unique_ptr<const structure::Module>>();
 	for (auto i = 0; i != options_.inputPaths.size(); ++i) {
+		const auto &input = options_.inputPaths[i];
+		if (!filterUsed && !collectStats) {
+			const auto j = manifest.constFind(input);
+			auto fingerprint = (j != manifest.cend()) ? *j : Fingerprint();
+			if (UpToDate(fingerprint, config)) {
+				fingerprint.tool = tool_;
+				updated.insert(input, std::move(fingerprint));
+				modules.push_back(nullptr);
+				continue;
+			}
+		}
 		auto parser = ParsedFile(cache, options_, i);
 		if (!parser.read()) {
 			return -1;
 		}
+		modules.push_back(parser.getResult());
+	}
 
-		const auto module = parser.getResult();
-		if (!write(*module)) {
+	if (filterUsed) {
+		auto used = CollectUsedNames(
+			options_.sourcesPaths,
+			options_.outputPath + '/' + kUsagesCacheFile,
+			&sources);
+		if (!used) {
 			return -1;
 		}
+		auto roots = std::vector<const structure::Module*>();
+		for (const auto &module : modules) {
+			roots.push_back(module.get());
+		}
+		AddReferencedNames(roots, *used);
+		usedNames_ = std::move(used);
 	}
-	if (!common::TouchTimestamp(options_.timestampPath)) {
+
+	for (auto i = 0; i != options_.inputPaths.size(); ++i) {
+		const auto &input = options_.inputPaths[i];
+		if (!modules[i]) {
+			continue;
+		}
+		const auto moduleConfig = this->moduleConfig(*modules[i], config);
+		if (filterUsed && !collectStats) {
+			const auto j = manifest.constFind(input);
+			auto fingerprint = (j != manifest.cend()) ? *j : Fingerprint();
+			if (UpToDate(fingerprint, moduleConfig)) {
+				fingerprint.tool = tool_;
+				updated.insert(input, std::move(fingerprint));
+				continue;
+			}
+		}
+		auto fingerprint = Fingerprint{ moduleConfig };
+		fingerprint.tool = tool_;
+		if (!write(*modules[i], fingerprint)) {
+			return -1;
+		}
+		updated.insert(input, std::move(fingerprint));
+	}
+	WriteManifest(manifestPath, updated);
+
+	if (options_.stats) {
+		PrintStats(stats_);
+	}
+	if (!options_.statsJsonPath.isEmpty()
+		&& !WriteStatsJson(options_.statsJsonPath, stats_)) {
+		return -1;
+	}
+
+	// Only the files that exist, a missing one would make it always dirty,
+	// for the probed ones that are missing their directories are listed.
+	auto dependencies = sources;
+	for (const auto &fingerprint : std::as_const(updated)) {
+		const auto &inputs = fingerprint.inputs;
+		for (auto i = inputs.cbegin(); i != inputs.cend(); ++i) {
+			dependencies.push_back(i.value().hash.isEmpty()
+				? ExistingDirectory(i.key())
+				: i.key());
+		}
+	}
+	if (!common::WriteDepfile(options_.timestampPath, dependencies)
+		|| !common::TouchTimestamp(options_.timestampPath)) {
 		return -1;
 	}
 	return 0;
 }
 
-bool Processor::write(const structure::Module &module) const {
+bool Processor::write(
+		const structure::Module &module,
+		Fingerprint &fingerprint) {
 	bool forceReGenerate = false;
 	QDir dir(options_.outputPath);
 	if (!dir.mkpath(".")) {
@@ -64,10 +323,46 @@ bool Processor::write(const structure::Module &module) const {
 		forceReGenerate
 	};
 
-	Generator generator(module, dstFilePath, project, options_.isPalette);
+	Generator generator(
+		module,
+		dstFilePath,
+		project,
+		options_.isPalette,
+		options_.valuesInSource,
+		options_.shareValues,
+		options_.packStructs,
+		options_.iconAtlas,
+		options_.refsHeaders,
+		usedNames_ ? &*usedNames_ : nullptr);
 	if (!generator.writeHeader() || !generator.writeSource()) {
 		return false;
 	}
+	fingerprint.outputs = QStringList{
+		dstFilePath + ".h",
+		dstFilePath + ".cpp",
+	};
+	if (options_.refsHeaders) {
+		fingerprint.outputs.push_back(dstFilePath + "_refs.h");
+	}
+	if (options_.snapshot && !options_.isPalette) {
+		if (!WriteSnapshot(
+				module,
+				dstFilePath,
+				options_.includePaths,
+				project,
+				usedNames_ ? &*usedNames_ : nullptr)) {
+			return false;
+		}
+		fingerprint.outputs.push_back(dstFilePath + ".snapshot");
+		fingerprint.outputs.push_back(dstFilePath + "_snapshot.h");
+		fingerprint.outputs.push_back(
+			QFileInfo(dstFilePath).dir().absoluteFilePath("style_snapshot.h"));
+	}
+	stats_.push_back(generator.stats());
+	AddModuleInputs(module, fingerprint.inputs);
+	for (const auto &path : generator.dependencies()) {
+		fingerprint.inputs.insert(path, common::StampFile(path));
+	}
 	return true;
 }
 
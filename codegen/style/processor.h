@@ -7,8 +7,17 @@
 #pragma once
 
 #include <memory>
+#include <optional>
+#include <vector>
+#include <QtCore/QByteArray>
+#include <QtCore/QDataStream>
+#include <QtCore/QMap>
+#include <QtCore/QSet>
 #include <QtCore/QString>
+#include <QtCore/QStringList>
+#include "codegen/common/file_hash.h"
 #include "codegen/style/options.h"
+#include "codegen/style/stats.h"
 
 namespace codegen {
 namespace style {
@@ -17,8 +26,25 @@ class Module;
 } // namespace structure
 class ParsedFile;
 
+// Everything a module output was generated from: the options, the .style
+// files with all the included ones and the icon files with content hashes.
+// The generator binary stamp is kept to hash it only when it is touched.
+struct Fingerprint {
+	QByteArray config;
+	QStringList outputs;
+	QMap<QString, common::FileStamp> inputs;
+	common::FileStamp tool;
+};
+
+// Input .style path -> fingerprint of its last generation.
+using Manifest = QMap<QString, Fingerprint>;
+
+QDataStream &operator<<(QDataStream &stream, const Fingerprint &value);
+QDataStream &operator>>(QDataStream &stream, Fingerprint &value);
+
 // Walks through a file, parses it and parses dependency files if necessary.
 // Uses Generator class to produce the final output.
+// Modules with an unchanged fingerprint in the manifest are skipped.
 class Processor {
 public:
 	explicit Processor(const Options &options);
@@ -31,9 +57,18 @@ public:
 	~Processor();
 
 private:
-	bool write(const structure::Module &module) const;
+	[[nodiscard]] QByteArray config() const;
+	[[nodiscard]] QByteArray moduleConfig(
+		const structure::Module &module,
+		const QByteArray &config) const;
+	bool write(
+		const structure::Module &module,
+		Fingerprint &fingerprint);
 
 	const Options &options_;
+	common::FileStamp tool_;
+	std::optional<QSet<QString>> usedNames_;
+	std::vector<ModuleStats> stats_;
 
 };
 
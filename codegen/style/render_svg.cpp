@@ -6,23 +6,47 @@
 //
 #include "codegen/style/render_svg.h"
 
+#include "codegen/common/logging.h"
+
+#include <algorithm>
+#include <atomic>
+#include <optional>
+#include <thread>
+#include <vector>
+#include <QtCore/QCryptographicHash>
+#include <QtCore/QDataStream>
+#include <QtCore/QDir>
 #include <QtCore/QFile>
+#include <QtCore/QFileInfo>
+#include <QtCore/QHash>
 #include <QtGui/QImage>
 #include <QtGui/QPainter>
 #include <QtSvg/QSvgRenderer>
 
 namespace codegen::style {
+namespace {
 
-int RenderSvg(const Options &options) {
-	auto file = QFile(options.renderSvgInput);
-	if (!file.open(QIODevice::ReadOnly)) {
-		return 1;
-	}
-	auto svg = QSvgRenderer(file.readAll());
+constexpr int kErrorCantReadManifest = 891;
+constexpr int kErrorBadManifestLine = 892;
+constexpr int kErrorRenderFailed = 893;
+
+constexpr auto kCacheVersion = quint32(1);
+const auto kCacheSuffix = QString(".cache");
+
+struct Task {
+	QString input;
+	QString output;
+	int size = 0;
+};
+
+[[nodiscard]] bool RenderSvgData(
+		const QByteArray &data,
+		const QString &output,
+		int size) {
+	auto svg = QSvgRenderer(data);
 	if (!svg.isValid()) {
-		return 1;
+		return false;
 	}
-	const auto size = options.renderSvgSize;
 	auto image = QImage(size, size, QImage::Format_ARGB32_Premultiplied);
 	image.fill(Qt::black);
 
@@ -32,7 +56,158 @@ int RenderSvg(const Options &options) {
 	svg.render(&p, QRectF(0, 0, size, size));
 	p.end();
 
-	return image.save(options.renderSvgOutput, "PNG") ? 0 : 1;
+	return image.save(output, "PNG");
+}
+
+// Each line is "input<TAB>output[<TAB>size]", so that the paths may contain
+// spaces. Relative paths are resolved from the manifest folder, the size
+// defaults to the one from the command line. Empty lines and lines
+// starting with '#' are skipped.
+[[nodiscard]] std::optional<std::vector<Task>> ReadManifest(
+		const Options &options) {
+	const auto &path = options.renderSvgManifest;
+	auto file = QFile(path);
+	if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) {
+		common::logError(kErrorCantReadManifest, path)
+			<< "can not open the manifest for reading";
+		return std::nullopt;
+	}
+	const auto base = QFileInfo(path).dir();
+	auto result = std::vector<Task>();
+	auto lineIndex = 0;
+	while (!file.atEnd()) {
+		++lineIndex;
+		const auto line = QString::fromUtf8(file.readLine()).trimmed();
+		if (line.isEmpty() || line.startsWith('#')) {
+			continue;
+		}
+		const auto parts = line.split('\t');
+		auto ok = (parts.size() == 2 || parts.size() == 3);
+		auto task = Task();
+		task.size = options.renderSvgSize;
+		if (ok) {
+			task.input = base.absoluteFilePath(parts[0]);
+			task.output = base.absoluteFilePath(parts[1]);
+			if (parts.size() == 3) {
+				task.size = parts[2].toInt(&ok);
+				ok = ok && (task.size > 0);
+			}
+		}
+		if (!ok) {
+			common::logError(kErrorBadManifestLine, path, lineIndex)
+				<< "expected: input.svg<TAB>output.png[<TAB>size]";
+			return std::nullopt;
+		}
+		result.push_back(std::move(task));
+	}
+	return result;
+}
+
+[[nodiscard]] QHash<QString, QByteArray> ReadCache(const QString &path) {
+	auto result = QHash<QString, QByteArray>();
+	auto file = QFile(path);
+	if (!file.open(QIODevice::ReadOnly)) {
+		return result;
+	}
+	auto stream = QDataStream(&file);
+	auto version = quint32(0);
+	stream >> version;
+	if (version != kCacheVersion) {
+		return result;
+	}
+	stream >> result;
+	return (stream.status() == QDataStream::Ok)
+		? result
+		: QHash<QString, QByteArray>();
+}
+
+void WriteCache(const QString &path, const QHash<QString, QByteArray> &cache) {
+	auto file = QFile(path);
+	if (!file.open(QIODevice::WriteOnly)) {
+		return;
+	}
+	auto stream = QDataStream(&file);
+	stream << kCacheVersion << cache;
+}
+
+} // namespace
+
+int RenderSvg(const Options &options) {
+	auto file = QFile(options.renderSvgInput);
+	if (!file.open(QIODevice::ReadOnly)) {
+		return 1;
+	}
+	return RenderSvgData(
+		file.readAll(),
+		options.renderSvgOutput,
+		options.renderSvgSize) ? 0 : 1;
+}
+
+int RenderSvgBatch(const Options &options) {
+	const auto tasks = ReadManifest(options);
+	if (!tasks) {
+		return 1;
+	}
+	const auto cachePath = options.renderSvgManifest + kCacheSuffix;
+	const auto cache = ReadCache(cachePath);
+
+	// Key of an output is the hash of its input content and the size.
+	auto keys = std::vector<QByteArray>(tasks->size());
+	auto failed = std::vector<char>(tasks->size());
+	auto next = std::atomic<size_t>(0);
+	const auto worker = [&] {
+		while (true) {
+			const auto index = next++;
+			if (index >= tasks->size()) {
+				return;
+			}
+			const auto &task = (*tasks)[index];
+			auto file = QFile(task.input);
+			if (!file.open(QIODevice::ReadOnly)) {
+				failed[index] = 1;
+				continue;
+			}
+			const auto data = file.readAll();
+			auto key = QCryptographicHash::hash(data, QCryptographicHash::Md5);
+			key.append(QByteArray::number(task.size));
+			keys[index] = key;
+
+			const auto i = cache.constFind(task.output);
+			if (i != cache.cend()
+				&& *i == key
+				&& QFileInfo::exists(task.output)) {
+				continue;
+			} else if (!RenderSvgData(data, task.output, task.size)) {
+				failed[index] = 1;
+			}
+		}
+	};
+	const auto count = std::max(
+		std::min(size_t(std::thread::hardware_concurrency()), tasks->size()),
+		size_t(1));
+	auto threads = std::vector<std::thread>();
+	for (auto i = size_t(1); i < count; ++i) {
+		threads.emplace_back(worker);
+	}
+	worker();
+	for (auto &thread : threads) {
+		thread.join();
+	}
+
+	auto result = 0;
+	auto updated = QHash<QString, QByteArray>();
+	for (auto i = size_t(0); i != tasks->size(); ++i) {
+		const auto &task = (*tasks)[i];
+		if (failed[i]) {
+			common::logError(kErrorRenderFailed, task.input)
+				<< "could not render to " << task.output.toStdString();
+			result = 1;
+		} else {
+			updated.insert(task.output, keys[i]);
+		}
+	}
+	WriteCache(cachePath, updated);
+	return result;
 }
 
 } // namespace codegen::style
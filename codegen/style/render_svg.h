@@ -12,4 +12,9 @@ namespace codegen::style {
 
 int RenderSvg(const Options &options);
 
+// Renders all tab separated "input output [size]" lines of the manifest
+// in parallel, skipping the outputs with the same input content and size
+// as last time.
+int RenderSvgBatch(const Options &options);
+
 } // namespace codegen::style
@@ -0,0 +1,535 @@
+// This file is part of Desktop App Toolkit,
+// a set of libraries for developing nice desktop applications.
+//
+// For license and copyright information please follow this link:
+// https://github.com/desktop-app/legal/blob/master/LEGAL
+//
+#include "codegen/style/snapshot.h"
+
+#include "base/crc32hash.h"
+#include "codegen/common/logging.h"
+#include "codegen/style/module.h"
+
+#include <cstring>
+#include <map>
+#include <vector>
+#include <QtCore/QDir>
+#include <QtCore/QFile>
+#include <QtCore/QFileInfo>
+#include <QtCore/QHash>
+#include <QtCore/QtEndian>
+
+namespace codegen {
+namespace style {
+namespace {
+
+using Tag = structure::TypeTag;
+
+constexpr int kErrorCantWriteSnapshot = 823;
+
+constexpr auto kMagic = quint32(0x59545354); // "TSTY"
+constexpr auto kVersion = quint32(2);
+constexpr auto kHeaderSize = quint32(16);
+constexpr auto kRefSize = quint32(8);
+constexpr auto kIconPartSize = 2 * kRefSize + 16;
+
+// Offset and size of the data in the variable area.
+struct Ref {
+	quint32 offset = 0;
+	quint32 size = 0;
+};
+
+// Colors are references to the palette entries by name.
+[[nodiscard]] QByteArray ColorName(const structure::Value &value) {
+	const auto &copy = value.copyOf();
+	if (!copy.isEmpty()) {
+		return copy.join('.').toUtf8();
+	}
+	const auto v = value.Color();
+	const auto rgba = (quint32(v.red) << 24)
+		| (quint32(v.green) << 16)
+		| (quint32(v.blue) << 8)
+		| quint32(v.alpha);
+	return '#' + QByteArray::number(rgba, 16).rightJustified(8, '0');
+}
+
+class Writer {
+public:
+	Writer(
+		const structure::Module &module,
+		const QStringList &includePaths,
+		const QSet<QString> *usedNames);
+
+	[[nodiscard]] bool prepare();
+	[[nodiscard]] bool writeBlob(const QString &path);
+	[[nodiscard]] bool writeShim(
+		const QString &path,
+		const QString &baseName,
+		const common::ProjectInfo &project) const;
+
+private:
+	[[nodiscard]] QString typeName(structure::Type type) const;
+	[[nodiscard]] quint32 recordSize(structure::Type type) const;
+	[[nodiscard]] bool isUsed(const structure::Variable &variable) const;
+	[[nodiscard]] QString maskPath(const QString &filename) const;
+	void addFields(structure::Type type);
+
+	void appendInt(QByteArray &to, qint32 value) const;
+	void appendRef(QByteArray &to, Ref ref) const;
+	[[nodiscard]] Ref addString(const QByteArray &value);
+	[[nodiscard]] bool appendValue(const structure::Value &value);
+
+	const structure::Module &module_;
+	const QStringList &includePaths_;
+	const QSet<QString> *usedNames_ = nullptr;
+
+	std::vector<std::pair<QString, quint32>> offsets_; // name -> offset
+	std::map<QString, std::vector<std::pair<QString, quint32>>> fields_;
+	QByteArray layout_;
+	quint32 recordsSize_ = 0;
+
+	QByteArray records_;
+	QByteArray pool_;
+	QHash<QByteArray, Ref> strings_;
+
+};
+
+Writer::Writer(
+	const structure::Module &module,
+	const QStringList &includePaths,
+	const QSet<QString> *usedNames)
+: module_(module)
+, includePaths_(includePaths)
+, usedNames_(usedNames) {
+}
+
+bool Writer::isUsed(const structure::Variable &variable) const {
+	return !usedNames_ || usedNames_->contains(variable.name.back());
+}
+
+// Icon files are found by ParsedFile in the include paths, in this order,
+// the mask is referred by the path relative to the one it was found in,
+// like "icons/menu/settings-flip_horizontal", same as in the .style file.
+QString Writer::maskPath(const QString &filename) const {
+	if (filename.startsWith("size://")) {
+		return filename;
+	}
+	for (const auto &path : includePaths_) {
+		if (filename.startsWith(path + '/')) {
+			return filename.mid(path.size() + 1);
+		}
+	}
+	return filename;
+}
+
+QString Writer::typeName(structure::Type type) const {
+	switch (type.tag) {
+	case Tag::Invalid: return QString();
+	case Tag::Int: return "int";
+	case Tag::Bool: return "bool";
+	case Tag::Double: return "double";
+	case Tag::Pixels: return "pixels";
+	case Tag::String: return "string";
+	case Tag::Color: return "color";
+	case Tag::Point: return "point";
+	case Tag::Size: return "size";
+	case Tag::Align: return "align";
+	case Tag::Margins: return "margins";
+	case Tag::Font: return "font";
+	case Tag::Icon: return "icon";
+	case Tag::Struct: return type.name.back();
+	}
+	return QString();
+}
+
+// Zero result means an error.
+quint32 Writer::recordSize(structure::Type type) const {
+	switch (type.tag) {
+	case Tag::Invalid: return 0;
+	case Tag::Int:
+	case Tag::Bool:
+	case Tag::Pixels: return 4;
+	case Tag::Double:
+	case Tag::Point:
+	case Tag::Size: return 8;
+	case Tag::Margins: return 16;
+	case Tag::String:
+	case Tag::Color:
+	case Tag::Align:
+	case Tag::Icon: return kRefSize;
+	case Tag::Font: return 8 + kRefSize;
+	case Tag::Struct: {
+		const auto value = module_.findStruct(type.name);
+		if (!value) {
+			return 0;
+		}
+		auto result = quint32(0);
+		for (const auto &field : value->fields) {
+			const auto size = recordSize(field.type);
+			if (!size) {
+				return 0;
+			}
+			result += size;
+		}
+		return result;
+	} break;
+	}
+	return 0;
+}
+
+bool Writer::prepare() {
+	auto offset = kHeaderSize;
+	auto result = module_.enumVariables([&](
+			const structure::Variable &variable) {
+		if (!isUsed(variable)) {
+			return true;
+		}
+		const auto type = variable.value.type();
+		const auto size = recordSize(type);
+		if (!size) {
+			return false;
+		}
+		const auto &name = variable.name.back();
+		offsets_.emplace_back(name, offset);
+		layout_.append((name + ':' + typeName(type) + ';').toUtf8());
+		offset += size;
+		return true;
+	});
+	if (!result) {
+		return false;
+	}
+	recordsSize_ = offset - kHeaderSize;
+
+	for (const auto &entry : offsets_) {
+		const auto variable = module_.findVariableInModule(
+			{ entry.first },
+			module_);
+		if (variable) {
+			addFields(variable->value.type());
+		}
+	}
+	return true;
+}
+
+// Field offsets for a struct type and all the struct types of its fields,
+// nested struct fields going one after another, in the definition order.
+void Writer::addFields(structure::Type type) {
+	if (type.tag != Tag::Struct) {
+		return;
+	}
+	const auto structName = type.name.back();
+	const auto value = module_.findStruct(type.name);
+	if (!value || fields_.find(structName) != fields_.end()) {
+		return;
+	}
+	auto &list = fields_[structName];
+	auto fieldOffset = quint32(0);
+	for (const auto &field : value->fields) {
+		list.emplace_back(field.name.back(), fieldOffset);
+		layout_.append((structName
+			+ '.'
+			+ field.name.back()
+			+ ':'
+			+ typeName(field.type)
+			+ ';').toUtf8());
+		fieldOffset += recordSize(field.type);
+	}
+	for (const auto &field : value->fields) {
+		addFields(field.type);
+	}
+}
+
+void Writer::appendInt(QByteArray &to, qint32 value) const {
+	const auto little = qToLittleEndian(value);
+	to.append(reinterpret_cast<const char*>(&little), sizeof(little));
+}
+
+void Writer::appendRef(QByteArray &to, Ref ref) const {
+	appendInt(to, qint32(ref.offset));
+	appendInt(to, qint32(ref.size));
+}
+
+Ref Writer::addString(const QByteArray &value) {
+	const auto i = strings_.constFind(value);
+	if (i != strings_.cend()) {
+		return *i;
+	}
+	const auto result = Ref{
+		kHeaderSize + recordsSize_ + quint32(pool_.size()),
+		quint32(value.size()),
+	};
+	pool_.append(value);
+	strings_.insert(value, result);
+	return result;
+}
+
+bool Writer::appendValue(const structure::Value &value) {
+	switch (value.type().tag) {
+	case Tag::Invalid: return false;
+	case Tag::Int:
+	case Tag::Pixels: appendInt(records_, value.Int()); break;
+	case Tag::Bool: appendInt(records_, value.Bool() ? 1 : 0); break;
+	case Tag::Double: {
+		const auto v = value.Double();
+		auto bits = quint64();
+		static_assert(sizeof(bits) == sizeof(v));
+		std::memcpy(&bits, &v, sizeof(v));
+		const auto little = qToLittleEndian(bits);
+		records_.append(
+			reinterpret_cast<const char*>(&little),
+			sizeof(little));
+	} break;
+	case Tag::String:
+	case Tag::Align: {
+		appendRef(records_, addString(QByteArray::fromStdString(value.String())));
+	} break;
+	case Tag::Color: {
+		appendRef(records_, addString(ColorName(value)));
+	} break;
+	case Tag::Point: {
+		const auto v = value.Point();
+		appendInt(records_, v.x);
+		appendInt(records_, v.y);
+	} break;
+	case Tag::Size: {
+		const auto v = value.Size();
+		appendInt(records_, v.width);
+		appendInt(records_, v.height);
+	} break;
+	case Tag::Margins: {
+		const auto v = value.Margins();
+		appendInt(records_, v.left);
+		appendInt(records_, v.top);
+		appendInt(records_, v.right);
+		appendInt(records_, v.bottom);
+	} break;
+	case Tag::Font: {
+		const auto v = value.Font();
+		appendInt(records_, v.size);
+		appendInt(records_, v.flags);
+		appendRef(records_, addString(QByteArray::fromStdString(v.family)));
+	} break;
+	case Tag::Icon: {
+		// Parts are the mask path, the color and the padding.
+		auto parts = QByteArray();
+		for (const auto &part : value.Icon().parts) {
+			appendRef(parts, addString(maskPath(part.filename).toUtf8()));
+			appendRef(parts, addString(ColorName(part.color)));
+			const auto padding = part.padding.Margins();
+			appendInt(parts, padding.left);
+			appendInt(parts, padding.top);
+			appendInt(parts, padding.right);
+			appendInt(parts, padding.bottom);
+		}
+		const auto count = quint32(parts.size()) / kIconPartSize;
+		const auto ref = addString(parts);
+		appendRef(records_, { ref.offset, count });
+	} break;
+	case Tag::Struct: {
+		const auto fields = value.Fields();
+		if (!fields) {
+			return false;
+		}
+		for (const auto &field : *fields) {
+			if (!appendValue(field.variable.value)) {
+				return false;
+			}
+		}
+	} break;
+	}
+	return true;
+}
+
+bool Writer::writeBlob(const QString &path) {
+	const auto result = module_.enumVariables([&](
+			const structure::Variable &variable) {
+		return !isUsed(variable) || appendValue(variable.value);
+	});
+	if (!result || quint32(records_.size()) != recordsSize_) {
+		common::logError(common::kErrorInternal, module_.filepath())
+			<< "bad snapshot records size";
+		return false;
+	}
+	auto content = QByteArray();
+	appendInt(content, qint32(kMagic));
+	appendInt(content, qint32(kVersion));
+	appendInt(content, base::crc32(layout_.constData(), layout_.size()));
+	appendInt(content, qint32(kHeaderSize + recordsSize_ + pool_.size()));
+	content.append(records_).append(pool_);
+
+	auto file = QFile(path);
+	if (file.open(QIODevice::ReadOnly)) {
+		if (file.readAll() == content) {
+			return true;
+		}
+		file.close();
+	}
+	if (!file.open(QIODevice::WriteOnly)
+		|| file.write(content) != content.size()) {
+		common::logError(kErrorCantWriteSnapshot, path)
+			<< "can not write the snapshot file";
+		return false;
+	}
+	return true;
+}
+
+bool Writer::writeShim(
+		const QString &path,
+		const QString &baseName,
+		const common::ProjectInfo &project) const {
+	auto shim = common::CppFile(path, project);
+	shim.include("styles/style_snapshot.h").newline();
+	shim.pushNamespace("style").pushNamespace("snapshot").pushNamespace(baseName);
+	shim.stream()
+		<< "inline constexpr std::uint32_t kLayoutHash = 0x"
+		<< QString::number(
+			quint32(base::crc32(layout_.constData(), layout_.size())),
+			16)
+		<< "U;\n"
+		<< "inline constexpr std::uint32_t kRecordsSize = "
+		<< recordsSize_
+		<< ";\n\n";
+	if (!fields_.empty()) {
+		shim.pushNamespace("field");
+		for (const auto &[name, list] : fields_) {
+			shim.pushNamespace(name);
+			for (const auto &[field, offset] : list) {
+				shim.stream()
+					<< "inline constexpr std::uint32_t "
+					<< field
+					<< " = "
+					<< offset
+					<< ";\n";
+			}
+			shim.popNamespace();
+		}
+		shim.popNamespace().newline();
+	}
+	shim.pushNamespace("offset");
+	for (const auto &[name, offset] : offsets_) {
+		shim.stream()
+			<< "inline constexpr std::uint32_t "
+			<< name
+			<< " = "
+			<< offset
+			<< ";\n";
+	}
+	shim.popNamespace();
+	shim.popNamespace().popNamespace().popNamespace();
+	return shim.finalize();
+}
+
+[[nodiscard]] bool WriteReader(
+		const QString &path,
+		const common::ProjectInfo &project) {
+	auto reader = common::CppFile(path, project);
+	reader.includeFromLibrary("bit");
+	reader.includeFromLibrary("cstdint");
+	reader.includeFromLibrary("cstring");
+	reader.includeFromLibrary("string_view");
+	reader.newline();
+	reader.pushNamespace("style").pushNamespace("snapshot");
+	reader.stream() << "\
+// Values are copied from the little-endian blob as they are.\n\
+static_assert(std::endian::native == std::endian::little,\n\
+	\"Style snapshots can be read only on little-endian targets.\");\n\
+\n\
+inline constexpr std::uint32_t kMagic = 0x" << QString::number(kMagic, 16) << "U;\n\
+inline constexpr std::uint32_t kVersion = " << kVersion << ";\n\
+inline constexpr std::uint32_t kHeaderSize = " << kHeaderSize << ";\n\
+inline constexpr std::uint32_t kIconPartSize = " << kIconPartSize << ";\n\
+\n\
+// Offset of the data in the blob and its size in bytes,\n\
+// for icons the size is the count of kIconPartSize parts,\n\
+// each with the mask path ref, the color name ref and 4 ints of padding.\n\
+// The mask path is relative to the include path, like \"icons/menu/info\".\n\
+struct Ref {\n\
+	std::uint32_t offset = 0;\n\
+	std::uint32_t size = 0;\n\
+};\n\
+\n\
+// All values are little-endian, pixels are not scaled.\n\
+// Colors are names of the palette entries or \"#rrggbbaa\".\n\
+class Blob {\n\
+public:\n\
+	Blob(const char *data, std::size_t size) : _data(data), _size(size) {\n\
+	}\n\
+\n\
+	// Pass kLayoutHash and kRecordsSize of the module shim.\n\
+	[[nodiscard]] bool valid(\n\
+			std::uint32_t layoutHash,\n\
+			std::uint32_t recordsSize) const {\n\
+		return (_size >= kHeaderSize)\n\
+			&& (_size - kHeaderSize >= recordsSize)\n\
+			&& (read<std::uint32_t>(0) == kMagic)\n\
+			&& (read<std::uint32_t>(4) == kVersion)\n\
+			&& (read<std::uint32_t>(8) == layoutHash)\n\
+			&& (read<std::uint32_t>(12) == _size);\n\
+	}\n\
+\n\
+	// Out of bounds reads give empty values.\n\
+	template <typename T>\n\
+	[[nodiscard]] T read(std::uint32_t offset) const {\n\
+		auto result = T();\n\
+		if (offset <= _size && _size - offset >= sizeof(T)) {\n\
+			std::memcpy(&result, _data + offset, sizeof(T));\n\
+		}\n\
+		return result;\n\
+	}\n\
+	[[nodiscard]] std::string_view string(std::uint32_t offset) const {\n\
+		const auto ref = read<Ref>(offset);\n\
+		return inside(ref.offset, ref.size)\n\
+			? std::string_view(_data + ref.offset, ref.size)\n\
+			: std::string_view();\n\
+	}\n\
+	[[nodiscard]] Ref iconParts(std::uint32_t offset) const {\n\
+		const auto ref = read<Ref>(offset);\n\
+		return (ref.size <= _size / kIconPartSize\n\
+			&& inside(ref.offset, ref.size * kIconPartSize))\n\
+			? ref\n\
+			: Ref();\n\
+	}\n\
+\n\
+private:\n\
+	[[nodiscard]] bool inside(\n\
+			std::uint32_t offset,\n\
+			std::uint32_t size) const {\n\
+		return (offset <= _size) && (_size - offset >= size);\n\
+	}\n\
+\n\
+	const char *_data = nullptr;\n\
+	std::size_t _size = 0;\n\
+\n\
+};\n";
+	reader.popNamespace().popNamespace();
+	return reader.finalize();
+}
+
+} // namespace
+
+bool WriteSnapshot(
+		const structure::Module &module,
+		const QString &destBasePath,
+		const QStringList &includePaths,
+		const common::ProjectInfo &project,
+		const QSet<QString> *usedNames) {
+	auto writer = Writer(module, includePaths, usedNames);
+	if (!writer.prepare()) {
+		return false;
+	}
+	const auto info = QFileInfo(destBasePath);
+	const auto baseName = info.baseName();
+	const auto readerProject = common::ProjectInfo{
+		project.name,
+		"style_snapshot",
+		project.forceReGenerate,
+	};
+	return writer.writeBlob(destBasePath + ".snapshot")
+		&& writer.writeShim(destBasePath + "_snapshot.h", baseName, project)
+		&& WriteReader(
+			info.dir().absoluteFilePath("style_snapshot.h"),
+			readerProject);
+}
+
+} // namespace style
+} // namespace codegen
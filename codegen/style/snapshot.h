@@ -0,0 +1,34 @@
+// This file is part of Desktop App Toolkit,
+// a set of libraries for developing nice desktop applications.
+//
+// For license and copyright information please follow this link:
+// https://github.com/desktop-app/legal/blob/master/LEGAL
+//
+#pragma once
+
+#include <QtCore/QSet>
+#include <QtCore/QString>
+#include <QtCore/QStringList>
+#include "codegen/common/cpp_file.h"
+
+namespace codegen {
+namespace style {
+namespace structure {
+class Module;
+} // namespace structure
+
+// Writes "destBasePath.snapshot" with all variable values of the module
+// in a fixed little-endian layout, "destBasePath_snapshot.h" with the
+// offsets of the variables in it and the shared "style_snapshot.h" reader.
+// Icon masks are referred by their paths relative to the include paths.
+// The values can be replaced by a new snapshot with the same layout hash
+// without recompiling, they are read with memcpy from the mapped file.
+bool WriteSnapshot(
+	const structure::Module &module,
+	const QString &destBasePath,
+	const QStringList &includePaths,
+	const common::ProjectInfo &project,
+	const QSet<QString> *usedNames);
+
+} // namespace style
+} // namespace codegen
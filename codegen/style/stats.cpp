@@ -0,0 +1,189 @@
+// This file is part of Desktop App Toolkit,
+// a set of libraries for developing nice desktop applications.
+//
+// For license and copyright information please follow this link:
+// https://github.com/desktop-app/legal/blob/master/LEGAL
+//
+#include "codegen/style/stats.h"
+
+#include "codegen/common/logging.h"
+
+#include <algorithm>
+#include <iostream>
+#include <QtCore/QFile>
+#include <QtCore/QJsonArray>
+#include <QtCore/QJsonDocument>
+#include <QtCore/QJsonObject>
+
+namespace codegen {
+namespace style {
+namespace {
+
+constexpr int kErrorCantWriteStats = 822;
+constexpr auto kTopContributors = size_t(10);
+
+// Struct types by the total size of their variables.
+[[nodiscard]] std::vector<StructStats> LargestStructs(
+		const ModuleStats &module) {
+	auto result = module.structs;
+	std::stable_sort(result.begin(), result.end(), [](
+			const StructStats &a,
+			const StructStats &b) {
+		return a.size * a.variables > b.size * b.variables;
+	});
+	if (result.size() > kTopContributors) {
+		result.resize(kTopContributors);
+	}
+	return result;
+}
+
+[[nodiscard]] std::vector<IconStats> LargestIcons(const ModuleStats &module) {
+	auto result = module.icons;
+	std::stable_sort(result.begin(), result.end(), [](
+			const IconStats &a,
+			const IconStats &b) {
+		return a.bytes > b.bytes;
+	});
+	if (result.size() > kTopContributors) {
+		result.resize(kTopContributors);
+	}
+	return result;
+}
+
+[[nodiscard]] QJsonObject ModuleToJson(const ModuleStats &module) {
+	auto types = QJsonObject();
+	for (const auto &[type, count] : module.variablesByType) {
+		types.insert(type, count);
+	}
+	const auto structToJson = [](const StructStats &value) {
+		return QJsonObject{
+			{ "name", value.name },
+			{ "size", value.size },
+			{ "variables", value.variables },
+		};
+	};
+	const auto iconToJson = [](const IconStats &value) {
+		return QJsonObject{
+			{ "file", value.filepath },
+			{ "bytes", value.bytes },
+			{ "format", QString(value.svg ? "svg" : "png") },
+		};
+	};
+	auto structs = QJsonArray();
+	for (const auto &value : module.structs) {
+		structs.push_back(structToJson(value));
+	}
+	auto largestStructs = QJsonArray();
+	for (const auto &value : LargestStructs(module)) {
+		largestStructs.push_back(structToJson(value));
+	}
+	auto largestIcons = QJsonArray();
+	for (const auto &value : LargestIcons(module)) {
+		largestIcons.push_back(iconToJson(value));
+	}
+	return QJsonObject{
+		{ "module", module.module },
+		{ "variables", types },
+		{ "structs", structs },
+		{ "icons", QJsonObject{
+			{ "count", int(module.icons.size()) },
+			{ "pngBytes", module.pngBytes },
+			{ "svgBytes", module.svgBytes },
+		} },
+		{ "pxValues", module.pxValues },
+		{ "fontFamilies", module.fontFamilies },
+		{ "initStatements", module.initStatements },
+		{ "largest", QJsonObject{
+			{ "structs", largestStructs },
+			{ "icons", largestIcons },
+		} },
+	};
+}
+
+} // namespace
+
+void PrintStats(const std::vector<ModuleStats> &modules) {
+	for (const auto &module : modules) {
+		std::cout << module.module.toStdString() << ":\n";
+		std::cout << "  variables:";
+		for (const auto &[type, count] : module.variablesByType) {
+			std::cout << ' ' << type.toStdString() << '=' << count;
+		}
+		std::cout << '\n';
+		std::cout
+			<< "  icons: "
+			<< module.icons.size()
+			<< " masks, png "
+			<< module.pngBytes
+			<< " bytes, svg "
+			<< module.svgBytes
+			<< " bytes\n";
+		std::cout
+			<< "  px values: "
+			<< module.pxValues
+			<< ", font families: "
+			<< module.fontFamilies
+			<< ", init statements: "
+			<< module.initStatements
+			<< '\n';
+		for (const auto &value : module.structs) {
+			std::cout
+				<< "  struct "
+				<< value.name.toStdString()
+				<< ": "
+				<< value.size
+				<< " bytes\n";
+		}
+		const auto structs = LargestStructs(module);
+		if (!structs.empty()) {
+			std::cout << "  largest structs:\n";
+			for (const auto &value : structs) {
+				std::cout
+					<< "    "
+					<< value.name.toStdString()
+					<< ": "
+					<< value.variables
+					<< " x "
+					<< value.size
+					<< " bytes\n";
+			}
+		}
+		const auto icons = LargestIcons(module);
+		if (!icons.empty()) {
+			std::cout << "  largest icons:\n";
+			for (const auto &value : icons) {
+				std::cout
+					<< "    "
+					<< value.filepath.toStdString()
+					<< ": "
+					<< value.bytes
+					<< " bytes\n";
+			}
+		}
+	}
+	std::cout.flush();
+}
+
+bool WriteStatsJson(
+		const QString &path,
+		const std::vector<ModuleStats> &modules) {
+	auto list = QJsonArray();
+	for (const auto &module : modules) {
+		list.push_back(ModuleToJson(module));
+	}
+	const auto content = QJsonDocument(QJsonObject{
+		{ "modules", list },
+	}).toJson();
+
+	auto file = QFile(path);
+	if (!file.open(QIODevice::WriteOnly)
+		|| file.write(content) != content.size()) {
+		common::logError(kErrorCantWriteStats, path)
+			<< "can not write the stats file";
+		return false;
+	}
+	return true;
+}
+
+} // namespace style
+} // namespace codegen
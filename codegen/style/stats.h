@@ -0,0 +1,47 @@
+// This file is part of Desktop App Toolkit,
+// a set of libraries for developing nice desktop applications.
+//
+// For license and copyright information please follow this link:
+// https://github.com/desktop-app/legal/blob/master/LEGAL
+//
+#pragma once
+
+#include <map>
+#include <vector>
+#include <QtCore/QString>
+
+namespace codegen {
+namespace style {
+
+struct StructStats {
+	QString name;
+	int size = 0; // estimated sizeof
+	int variables = 0;
+};
+
+struct IconStats {
+	QString filepath;
+	qint64 bytes = 0;
+	bool svg = false;
+};
+
+// What a generated module consists of, filled by Generator.
+struct ModuleStats {
+	QString module;
+	std::map<QString, int> variablesByType;
+	std::vector<StructStats> structs;
+	std::vector<IconStats> icons;
+	qint64 pngBytes = 0;
+	qint64 svgBytes = 0;
+	int pxValues = 0;
+	int fontFamilies = 0;
+	int initStatements = 0; // assignments, px values and font families
+};
+
+void PrintStats(const std::vector<ModuleStats> &modules);
+[[nodiscard]] bool WriteStatsJson(
+	const QString &path,
+	const std::vector<ModuleStats> &modules);
+
+} // namespace style
+} // namespace codegen
@@ -0,0 +1,268 @@
+// This file is part of Desktop App Toolkit,
+// a set of libraries for developing nice desktop applications.
+//
+// For license and copyright information please follow this link:
+// https://github.com/desktop-app/legal/blob/master/LEGAL
+//
+#include "codegen/style/subsets.h"
+
+#include "codegen/common/logging.h"
+#include "codegen/common/source_scan.h"
+
+#include <set>
+#include <vector>
+#include <QtCore/QDateTime>
+#include <QtCore/QDir>
+#include <QtCore/QFile>
+#include <QtCore/QFileInfo>
+#include <QtCore/QHash>
+
+namespace codegen {
+namespace style {
+namespace {
+
+constexpr int kErrorCantReadRefs    = 881;
+constexpr int kErrorCantReadSource  = 882;
+constexpr int kErrorCantWriteSubset = 883;
+constexpr int kErrorSameRelativePath = 884;
+
+constexpr auto kCacheVersion = quint32(2);
+
+const auto kRefsSuffix = QString("_refs.h");
+const auto kSubsetsFolder = QString("style_subsets");
+const auto kCacheFile = QString("style_subsets/.cache");
+const auto kExternStart = QByteArray("extern const ");
+const auto kConstexprStart = QByteArray("constexpr ");
+const auto kStructStart = QByteArray("struct ");
+
+const auto kScanRules = common::ScanRules{
+	.tokenPrefix = "st::",
+	.includes = true,
+};
+
+struct Declarations {
+	std::vector<QByteArray> code;
+	std::vector<QByteArray> types;
+	QHash<QByteArray, int> byName;
+	std::set<QByteArray> structs;
+	QByteArray state;
+};
+
+// Declaration types look like "style::FlatButton" or "int".
+[[nodiscard]] QByteArray StructName(const QByteArray &type) {
+	return type.startsWith("style::") ? type.mid(7) : QByteArray();
+}
+
+[[nodiscard]] bool ReadDeclarations(
+		const QString &genPath,
+		Declarations &result) {
+	const auto list = QDir(genPath).entryInfoList(
+		{ '*' + kRefsSuffix },
+		QDir::Files,
+		QDir::Name);
+	for (const auto &info : list) {
+		const auto path = info.absoluteFilePath();
+		auto file = QFile(path);
+		if (!file.open(QIODevice::ReadOnly)) {
+			common::logError(kErrorCantReadRefs, path)
+				<< "can not open the generated refs header for reading";
+			return false;
+		}
+		const auto content = file.readAll();
+		file.close();
+
+		result.state += info.fileName().toUtf8()
+			+ ':' + QByteArray::number(info.lastModified().toMSecsSinceEpoch())
+			+ ':' + QByteArray::number(info.size()) + ';';
+		for (const auto &line : content.split('\n')) {
+			if (line.startsWith(kStructStart) && line.endsWith(';')) {
+				result.structs.emplace(line.mid(
+					kStructStart.size(),
+					line.size() - kStructStart.size() - 1));
+				continue;
+			}
+			auto type = QByteArray();
+			auto name = QByteArray();
+			if (line.startsWith(kExternStart)) {
+				const auto ref = line.indexOf(" &", kExternStart.size());
+				const auto end = line.indexOf(';', ref);
+				if (ref < 0 || end < 0) {
+					common::logError(kErrorCantReadRefs, path)
+						<< "bad declaration: " << line.constData();
+					return false;
+				}
+				type = line.mid(kExternStart.size(), ref - kExternStart.size());
+				name = line.mid(ref + 2, end - ref - 2);
+			} else if (line.startsWith(kConstexprStart)) {
+				const auto assign = line.indexOf(" = ", kConstexprStart.size());
+				const auto space = (assign < 0)
+					? -1
+					: line.lastIndexOf(' ', assign - 1);
+				if (space < 0) {
+					common::logError(kErrorCantReadRefs, path)
+						<< "bad declaration: " << line.constData();
+					return false;
+				}
+				type = line.mid(
+					kConstexprStart.size(),
+					space - kConstexprStart.size());
+				name = line.mid(space + 1, assign - space - 1);
+			} else {
+				continue;
+			}
+			result.byName.insert(name, int(result.code.size()));
+			result.types.push_back(type);
+			result.code.push_back(line);
+		}
+	}
+	if (result.code.empty()) {
+		common::logError(kErrorCantReadRefs, genPath)
+			<< "no style declarations found";
+		return false;
+	}
+	return true;
+}
+
+[[nodiscard]] QByteArray Signature(const std::vector<int> &names) {
+	auto result = QByteArray();
+	for (const auto name : names) {
+		result += QByteArray::number(name) + ' ';
+	}
+	return result;
+}
+
+[[nodiscard]] bool WriteSubset(
+		const QString &path,
+		const Declarations &declarations,
+		const std::vector<int> &names,
+		const common::ProjectInfo &project) {
+	auto structs = std::set<QByteArray>();
+	for (const auto index : names) {
+		const auto name = StructName(declarations.types[index]);
+		if (declarations.structs.find(name) != declarations.structs.end()) {
+			structs.emplace(name);
+		}
+	}
+
+	auto file = common::CppFile(path, project);
+	file.include("ui/style/style_core.h").newline();
+	if (!structs.empty()) {
+		file.pushNamespace("style");
+		for (const auto &name : structs) {
+			file.stream() << kStructStart << name << ";\n";
+		}
+		file.popNamespace().newline();
+	}
+	file.pushNamespace("st");
+	for (const auto index : names) {
+		file.stream() << declarations.code[index] << "\n";
+	}
+	file.popNamespace();
+	if (!file.finalize()) {
+		common::logError(kErrorCantWriteSubset, path)
+			<< "can not write the style refs subset";
+		return false;
+	}
+	return true;
+}
+
+} // namespace
+
+bool WriteSubsets(
+		const QString &genPath,
+		const QStringList &sourcesPaths,
+		const common::ProjectInfo &project) {
+	auto declarations = Declarations();
+	if (!ReadDeclarations(genPath, declarations)) {
+		return false;
+	}
+	const auto cachePath = genPath + '/' + kCacheFile;
+	const auto cache = common::ReadSourcesCache(cachePath, kCacheVersion);
+	const auto refsSame = (cache.state == declarations.state);
+
+	auto files = common::CollectSources(sourcesPaths);
+	if (!common::ScanSources(
+			files,
+			cache,
+			kScanRules,
+			kErrorCantReadSource)) {
+		return false;
+	}
+	const auto count = int(files.size());
+
+	// Subsets and their signatures are keyed by the path relative to the
+	// sources root, so it can't be the same under two different roots.
+	for (auto i = 1; i < count; ++i) {
+		if (files[i].relative == files[i - 1].relative) {
+			common::logError(kErrorSameRelativePath, files[i].absolute)
+				<< "has the same relative path as "
+				<< files[i - 1].absolute.toStdString();
+			return false;
+		}
+	}
+	auto used = std::vector<std::vector<int>>(count);
+	for (auto i = 0; i != count; ++i) {
+		for (const auto &token : files[i].scanned.tokens) {
+			const auto j = declarations.byName.constFind(token);
+			if (j != declarations.byName.cend()) {
+				used[i].push_back(*j);
+			}
+		}
+	}
+	const auto included = common::ResolveIncludes(files, sourcesPaths);
+
+	// Files including each other share one closure, every component is
+	// computed once from its own files and the already known successors.
+	const auto components = common::CondenseIncludes(included);
+	auto closures = std::vector<common::Bits>(
+		components.count,
+		common::EmptyBits(int(declarations.code.size())));
+	for (auto i = 0; i != count; ++i) {
+		auto &closure = closures[components.index[i]];
+		for (const auto name : used[i]) {
+			common::SetBit(closure, name);
+		}
+	}
+	for (auto component = 0; component != components.count; ++component) {
+		auto &closure = closures[component];
+		for (const auto file : components.files[component]) {
+			for (const auto to : included[file]) {
+				const auto successor = components.index[to];
+				if (successor != component) {
+					common::UniteBits(closure, closures[successor]);
+				}
+			}
+		}
+	}
+
+	auto next = common::SourcesCache();
+	next.state = declarations.state;
+
+	const auto subsets = genPath + '/' + kSubsetsFolder;
+	auto names = std::vector<int>();
+	for (auto i = 0; i != count; ++i) {
+		next.scanned.insert(files[i].absolute, files[i].scanned);
+		if (!files[i].unit) {
+			continue;
+		}
+		names = common::BitsList(closures[components.index[i]]);
+		const auto signature = Signature(names);
+		next.signatures.insert(files[i].relative, signature);
+
+		const auto path = subsets + '/' + files[i].relative + ".h";
+		const auto known = cache.signatures.constFind(files[i].relative);
+		if (refsSame
+			&& known != cache.signatures.cend()
+			&& *known == signature
+			&& QFileInfo::exists(path)) {
+			continue;
+		} else if (!WriteSubset(path, declarations, names, project)) {
+			return false;
+		}
+	}
+	common::WriteSourcesCache(cachePath, kCacheVersion, cache, next);
+	return true;
+}
+
+} // namespace style
+} // namespace codegen
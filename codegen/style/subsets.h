@@ -0,0 +1,26 @@
+// This file is part of Desktop App Toolkit,
+// a set of libraries for developing nice desktop applications.
+//
+// For license and copyright information please follow this link:
+// https://github.com/desktop-app/legal/blob/master/LEGAL
+//
+#pragma once
+
+#include <QtCore/QString>
+#include <QtCore/QStringList>
+#include "codegen/common/cpp_file.h"
+
+namespace codegen {
+namespace style {
+
+// Writes styles/style_subsets/<source>.h for each translation unit with
+// only the st:: declarations it uses, composed from styles/*_refs.h.
+// A unit compiled with STYLE_REFS_SUBSET pointing to its subset
+// is not rebuilt when a variable it does not use is changed.
+bool WriteSubsets(
+	const QString &genPath,
+	const QStringList &sourcesPaths,
+	const common::ProjectInfo &project);
+
+} // namespace style
+} // namespace codegen
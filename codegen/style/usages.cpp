@@ -0,0 +1,123 @@
+// This file is part of Desktop App Toolkit,
+// a set of libraries for developing nice desktop applications.
+//
+// For license and copyright information please follow this link:
+// https://github.com/desktop-app/legal/blob/master/LEGAL
+//
+#include "codegen/style/usages.h"
+
+#include "codegen/common/source_scan.h"
+#include "codegen/style/module.h"
+
+#include <algorithm>
+#include <functional>
+
+namespace codegen {
+namespace style {
+namespace {
+
+constexpr int kErrorCantReadSource = 871;
+
+constexpr auto kCacheVersion = quint32(2);
+
+const auto kScanRules = common::ScanRules{
+	.tokenPrefix = "st::",
+};
+
+void AddValueReferences(const structure::Value &value, QSet<QString> &names) {
+	const auto &copy = value.copyOf();
+	if (!copy.isEmpty()) {
+		names.insert(copy.front());
+		return;
+	}
+	switch (value.type().tag) {
+	case structure::TypeTag::Icon: {
+		for (const auto &part : value.Icon().parts) {
+			AddValueReferences(part.color, names);
+			AddValueReferences(part.padding, names);
+		}
+	} break;
+	case structure::TypeTag::Struct: {
+		if (const auto fields = value.Fields()) {
+			for (const auto &field : *fields) {
+				AddValueReferences(field.variable.value, names);
+			}
+		}
+	} break;
+	default: break;
+	}
+}
+
+} // namespace
+
+std::optional<QSet<QString>> CollectUsedNames(
+		const QStringList &sourcesPaths,
+		const QString &cachePath,
+		QStringList *scanned) {
+	const auto cache = common::ReadSourcesCache(cachePath, kCacheVersion);
+	auto files = common::CollectSources(sourcesPaths);
+	if (!common::ScanSources(
+			files,
+			cache,
+			kScanRules,
+			kErrorCantReadSource)) {
+		return std::nullopt;
+	}
+	auto next = common::SourcesCache();
+	auto found = QSet<QByteArray>();
+	for (const auto &file : files) {
+		if (scanned) {
+			scanned->push_back(file.absolute);
+		}
+		for (const auto &token : file.scanned.tokens) {
+			found.insert(token);
+		}
+		next.scanned.insert(file.absolute, file.scanned);
+	}
+	common::WriteSourcesCache(cachePath, kCacheVersion, cache, next);
+
+	auto result = QSet<QString>();
+	result.reserve(found.size());
+	for (const auto &name : std::as_const(found)) {
+		result.insert(QString::fromLatin1(name));
+	}
+	return result;
+}
+
+void AddReferencedNames(
+		const std::vector<const structure::Module*> &modules,
+		QSet<QString> &names) {
+	auto all = std::vector<const structure::Module*>();
+	std::function<bool(const structure::Module&)> collect = [&](
+			const structure::Module &module) {
+		if (std::find(all.begin(), all.end(), &module) == all.end()) {
+			all.push_back(&module);
+			module.enumIncludes(collect);
+		}
+		return true;
+	};
+	for (const auto module : modules) {
+		collect(*module);
+	}
+
+	auto checked = QSet<QString>();
+	while (true) {
+		const auto was = names.size();
+		for (const auto module : all) {
+			module->enumVariables([&](const structure::Variable &variable) {
+				const auto &name = variable.name.back();
+				if (names.contains(name) && !checked.contains(name)) {
+					checked.insert(name);
+					AddValueReferences(variable.value, names);
+				}
+				return true;
+			});
+		}
+		if (names.size() == was) {
+			break;
+		}
+	}
+}
+
+} // namespace style
+} // namespace codegen
@@ -0,0 +1,36 @@
+// This file is part of Desktop App Toolkit,
+// a set of libraries for developing nice desktop applications.
+//
+// For license and copyright information please follow this link:
+// https://github.com/desktop-app/legal/blob/master/LEGAL
+//
+#pragma once
+
+#include <optional>
+#include <vector>
+#include <QtCore/QSet>
+#include <QtCore/QString>
+#include <QtCore/QStringList>
+
+namespace codegen {
+namespace style {
+namespace structure {
+class Module;
+} // namespace structure
+
+// Collects all names used as "st::name" in .cpp/.h/.mm files of the sources.
+// Scan results are cached per file by modification time and size.
+// If "scanned" is set the paths of all those files are added to it.
+[[nodiscard]] std::optional<QSet<QString>> CollectUsedNames(
+	const QStringList &sourcesPaths,
+	const QString &cachePath,
+	QStringList *scanned = nullptr);
+
+// Adds the variables the generated code of the used ones refers to,
+// like "st::parent" for "child: parent;", through all included modules.
+void AddReferencedNames(
+	const std::vector<const structure::Module*> &modules,
+	QSet<QString> &names);
+
+} // namespace style
+} // namespace codegen